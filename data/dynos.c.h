@@ -7,7 +7,9 @@
 void *dynos_update_cmd         (void *cmd);
 void  dynos_update_gfx         ();
 void  dynos_update_opt         (void *pad);
-s32   dynos_gfx_import_texture (void **output, void *ptr, s32 tile, void *grapi, void **hashmap, void *pool, s32 *poolpos, s32 poolsize);
+s32   dynos_gfx_import_texture (void **key, void *ptr, const u8 **data, s32 *width, s32 *height);
+bool  dynos_gfx_is_texture     (void *ptr);
+void  dynos_gfx_for_each_texture(void (*func)(void *ptr, void *user), void *user);
 void  dynos_gfx_swap_animations(void *ptr);
 
 #endif
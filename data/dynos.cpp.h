@@ -634,7 +634,9 @@ void DynOS_Opt_DrawPrompt(DynosOption *aCurrentMenu, DynosOption *aOptionsMenu,
 //
 
 u8 *DynOS_Gfx_TextureConvertToRGBA32(const u8 *aData, u64 aLength, s32 aFormat, s32 aSize, const u8 *aPalette);
-bool DynOS_Gfx_ImportTexture(void **aOutput, void *aPtr, s32 aTile, void *aGfxRApi, void **aHashMap, void *aPool, u32 *aPoolPos, u32 aPoolSize);
+s32 DynOS_Gfx_ImportTexture(void **aKey, void *aPtr, const u8 **aData, s32 *aWidth, s32 *aHeight);
+bool DynOS_Gfx_IsTexture(void *aPtr);
+void DynOS_Gfx_ForEachTexture(void (*aFunc)(void *aPtr, void *aUser), void *aUser);
 Array<ActorGfx> &DynOS_Gfx_GetActorList();
 Array<PackData *> &DynOS_Gfx_GetPacks();
 Array<String> DynOS_Gfx_Init();
@@ -13,8 +13,16 @@ void dynos_update_opt(void *pad) {
     return DynOS_UpdateOpt(pad);
 }
 
-s32 dynos_gfx_import_texture(void **output, void *ptr, s32 tile, void *grapi, void **hashmap, void *pool, s32 *poolpos, s32 poolsize) {
-    return DynOS_Gfx_ImportTexture(output, ptr, tile, grapi, hashmap, pool, (u32 *) poolpos, (u32) poolsize);
+s32 dynos_gfx_import_texture(void **key, void *ptr, const u8 **data, s32 *width, s32 *height) {
+    return DynOS_Gfx_ImportTexture(key, ptr, data, width, height);
+}
+
+bool dynos_gfx_is_texture(void *ptr) {
+    return DynOS_Gfx_IsTexture(ptr);
+}
+
+void dynos_gfx_for_each_texture(void (*func)(void *ptr, void *user), void *user) {
+    return DynOS_Gfx_ForEachTexture(func, user);
 }
 
 void dynos_gfx_swap_animations(void *ptr) {
@@ -1,7 +1,4 @@
 #include "dynos.cpp.h"
-extern "C" {
-#include "pc/gfx/gfx_rendering_api.h"
-}
 
 //
 // Conversion
@@ -177,71 +174,6 @@ u8 *DynOS_Gfx_TextureConvertToRGBA32(const u8 *aData, u64 aLength, s32 aFormat,
     return NULL;
 }
 
-//
-// Upload
-//
-
-typedef struct GfxRenderingAPI GRAPI;
-static void DynOS_Gfx_UploadTexture(DataNode<TexData> *aNode, GRAPI *aGfxRApi, s32 aTile, s32 aTexId) {
-    aGfxRApi->select_texture(aTile, aTexId);
-    aGfxRApi->upload_texture(aNode->mData->mRawData.begin(), aNode->mData->mRawWidth, aNode->mData->mRawHeight);
-    aNode->mData->mUploaded = true;
-}
-
-//
-// Cache
-//
-
-struct THN {
-    struct THN *mNext;
-    const void *mAddr; // Contains the pointer to the DataNode<TexData> struct, NOT the actual texture data
-    u8 mFmt, mSiz;
-    s32 mTexId;
-    u8 mCms, mCmt;
-    bool mLInf;
-};
-
-static bool DynOS_Gfx_CacheTexture(THN **aOutput, DataNode<TexData> *aNode, s32 aTile, GRAPI *aGfxRApi, THN **aHashMap, THN *aPool, u32 *aPoolPos, u32 aPoolSize) {
-
-    // Find texture in cache
-    uintptr_t _Hash = ((uintptr_t) aNode) & ((aPoolSize * 2) - 1);
-    THN **_Node = &(aHashMap[_Hash]);
-    while ((*_Node) != NULL && ((*_Node) - aPool) < (*aPoolPos)) {
-        if ((*_Node)->mAddr == (const void *) aNode) {
-            aGfxRApi->select_texture(aTile, (*_Node)->mTexId);
-            if (!aNode->mData->mUploaded) {
-                DynOS_Gfx_UploadTexture(aNode, aGfxRApi, aTile, (*_Node)->mTexId);
-            }
-            (*aOutput) = (*_Node);
-            return true;
-        }
-        _Node = &(*_Node)->mNext;
-    }
-
-    // If cache is full, clear cache
-    if ((*aPoolPos) == aPoolSize) {
-        (*aPoolPos) = 0;
-        _Node = &aHashMap[_Hash];
-    }
-
-    // Add new texture to cache
-    (*_Node) = &aPool[(*aPoolPos)++];
-    if (!(*_Node)->mAddr) {
-        (*_Node)->mTexId = aGfxRApi->new_texture();
-    }
-    aGfxRApi->select_texture(aTile, (*_Node)->mTexId);
-    aGfxRApi->set_sampler_parameters(aTile, false, 0, 0);
-    (*_Node)->mCms  = 0;
-    (*_Node)->mCmt  = 0;
-    (*_Node)->mLInf = false;
-    (*_Node)->mNext = NULL;
-    (*_Node)->mAddr = aNode;
-    (*_Node)->mFmt  = G_IM_FMT_RGBA;
-    (*_Node)->mSiz  = G_IM_SIZ_32b;
-    (*aOutput)      = (*_Node);
-    return false;
-}
-
 //
 // Import
 //
@@ -260,26 +192,37 @@ static DataNode<TexData> *DynOS_Gfx_RetrieveNode(void *aPtr) {
     return NULL;
 }
 
-static bool DynOS_Gfx_ImportTexture_Typed(THN **aOutput, void *aPtr, s32 aTile, GRAPI *aGfxRApi, THN **aHashMap, THN *aPool, u32 *aPoolPos, u32 aPoolSize) {
+// The texture cache lives in gfx_pc.c, keyed by the data node
+// Returns 0 if aPtr isn't a DynOS texture, 2 if it has to be uploaded again since it was reloaded
+s32 DynOS_Gfx_ImportTexture(void **aKey, void *aPtr, const u8 **aData, s32 *aWidth, s32 *aHeight) {
     DataNode<TexData> *_Node = DynOS_Gfx_RetrieveNode(aPtr);
-    if (_Node) {
-        if (!DynOS_Gfx_CacheTexture(aOutput, _Node, aTile, aGfxRApi, aHashMap, aPool, aPoolPos, aPoolSize)) {
-            DynOS_Gfx_UploadTexture(_Node, aGfxRApi, aTile, (*aOutput)->mTexId);
-        }
-        return true;
+    if (!_Node) {
+        return 0;
+    }
+    *aKey    = (void *) _Node;
+    *aData   = _Node->mData->mRawData.begin();
+    *aWidth  = _Node->mData->mRawWidth;
+    *aHeight = _Node->mData->mRawHeight;
+    if (!_Node->mData->mUploaded) {
+        _Node->mData->mUploaded = true;
+        return 2;
     }
-    return false;
+    return 1;
+}
+
+// Same lookup as DynOS_Gfx_ImportTexture, but leaves the upload state alone
+bool DynOS_Gfx_IsTexture(void *aPtr) {
+    return DynOS_Gfx_RetrieveNode(aPtr) != NULL;
 }
 
-bool DynOS_Gfx_ImportTexture(void **aOutput, void *aPtr, s32 aTile, void *aGfxRApi, void **aHashMap, void *aPool, u32 *aPoolPos, u32 aPoolSize) {
-    return DynOS_Gfx_ImportTexture_Typed(
-        (THN **)  aOutput,
-        (void *)  aPtr,
-        (s32)     aTile,
-        (GRAPI *) aGfxRApi,
-        (THN **)  aHashMap,
-        (THN *)   aPool,
-        (u32 *)   aPoolPos,
-        (u32)     aPoolSize
-    );
+// Calls aFunc on every texture of the loaded packs, to be precached
+void DynOS_Gfx_ForEachTexture(void (*aFunc)(void *aPtr, void *aUser), void *aUser) {
+    Array<ActorGfx> &pActorGfxList = DynOS_Gfx_GetActorList();
+    for (auto& _ActorGfx : pActorGfxList) {
+        if (_ActorGfx.mGfxData) {
+            for (auto &_Node : _ActorGfx.mGfxData->mTextures) {
+                aFunc((void *) _Node, aUser);
+            }
+        }
+    }
 }
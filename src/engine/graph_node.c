@@ -10,6 +10,7 @@
 #include "game/rendering_graph_node.h"
 #include "game/area.h"
 #include "geo_layout.h"
+#include "saturn/imgui/saturn_imgui.h"
 
 // unused Mtx(s)
 s16 identityMtx[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
@@ -851,7 +852,8 @@ s16 geo_update_animation_frame(struct GraphNodeObject_sub *obj, s32 *accelAssist
 
     anim = obj->curAnim;
 
-    if ((obj->animTimer == gAreaUpdateCounter && gCurrentObject->behavior != bhvMario) || anim->flags & ANIM_FLAG_2) {
+    if ((obj->animTimer == gAreaUpdateCounter && gCurrentObject->behavior != bhvMario) || anim->flags & ANIM_FLAG_2
+        || saturn_imgui_is_motion_blur_subframe()) {
         if (accelAssist != NULL) {
             accelAssist[0] = obj->animFrameAccelAssist;
         }
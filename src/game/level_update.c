@@ -39,6 +39,7 @@
 #include "behavior_data.h"
 
 #include "saturn/saturn.h"
+#include "saturn/imgui/saturn_imgui.h"
 
 #define PLAY_MODE_NORMAL 0
 #define PLAY_MODE_PAUSED 2
@@ -998,7 +999,10 @@ s32 play_mode_normal(void) {
     warp_area();
     check_instant_warp();
 
-    if (sTimerRunning && gHudDisplay.timer < 17999) {
+    // motion blur sub-frames keep the world on the output frame's tick
+    bool subframe = saturn_imgui_is_motion_blur_subframe();
+
+    if (sTimerRunning && gHudDisplay.timer < 17999 && !subframe) {
         gHudDisplay.timer += 1;
     }
 
@@ -1006,7 +1010,7 @@ s32 play_mode_normal(void) {
         gInitObjects++;
         area_update_objects();
     }
-    update_objects_in_list(OBJ_LIST_PLAYER);
+    if (!subframe) update_objects_in_list(OBJ_LIST_PLAYER);
     saturn_actor_update_all();
     update_hud_values();
 
@@ -494,6 +494,146 @@ static void geo_process_camera(struct GraphNodeCamera *node) {
     gMatStackIndex--;
 }
 
+/**
+ * Frustum culling. Display lists are bounded by a sphere around every vertex
+ * they load, measured the first time each list is drawn and cached by its
+ * address. The first command of the list is kept alongside, so a list that
+ * was freed and replaced by another (like a swapped custom model) gets
+ * measured again. Lists that can't be bounded, like ones loading their own
+ * matrices, are always drawn.
+ */
+
+#define DL_BOUNDS_CACHE_SIZE 4096
+#define DL_BOUNDS_MAX_DEPTH 8
+#define DL_BOUNDS_MAX_COMMANDS 0x10000
+
+struct DisplayListBounds {
+    Gfx *displayList;
+    uintptr_t check[2];
+    Vec3f center;
+    f32 radius; // negative if the list is always drawn
+};
+
+static struct DisplayListBounds sDisplayListBounds[DL_BOUNDS_CACHE_SIZE];
+
+static s32 geo_measure_display_list(Gfx *cmd, Vec3f min, Vec3f max, s32 depth, s32 *numCommands) {
+    if (depth > DL_BOUNDS_MAX_DEPTH) {
+        return FALSE;
+    }
+    for (;; cmd++) {
+        if (++*numCommands > DL_BOUNDS_MAX_COMMANDS) {
+            return FALSE;
+        }
+        switch (cmd->words.w0 >> 24) {
+            case G_VTX: {
+#ifdef F3DEX_GBI_2
+                u32 count = (cmd->words.w0 >> 12) & 0xFF;
+#elif defined(F3DEX_GBI) || defined(F3DLP_GBI)
+                u32 count = (cmd->words.w0 >> 10) & 0x3F;
+#else
+                u32 count = (cmd->words.w0 & 0xFFFF) / sizeof(Vtx);
+#endif
+                Vtx *vtx = (Vtx *) cmd->words.w1;
+                for (u32 i = 0; i < count; i++) {
+                    for (s32 j = 0; j < 3; j++) {
+                        if (vtx[i].v.ob[j] < min[j]) min[j] = vtx[i].v.ob[j];
+                        if (vtx[i].v.ob[j] > max[j]) max[j] = vtx[i].v.ob[j];
+                    }
+                }
+                break;
+            }
+            case G_MTX:
+            case G_POPMTX:
+                return FALSE;
+            case G_DL:
+                if (((cmd->words.w0 >> 16) & 1) == G_DL_PUSH) {
+                    if (!geo_measure_display_list((Gfx *) cmd->words.w1, min, max, depth + 1, numCommands)) {
+                        return FALSE;
+                    }
+                } else {
+                    cmd = (Gfx *) cmd->words.w1 - 1;
+                }
+                break;
+            case G_ENDDL:
+                return TRUE;
+        }
+    }
+}
+
+static struct DisplayListBounds *geo_get_display_list_bounds(Gfx *dl) {
+    struct DisplayListBounds *bounds = &sDisplayListBounds[((uintptr_t) dl >> 3) % DL_BOUNDS_CACHE_SIZE];
+    Vec3f min = { 1e30f, 1e30f, 1e30f };
+    Vec3f max = { -1e30f, -1e30f, -1e30f };
+    s32 numCommands = 0;
+
+    if (bounds->displayList == dl && bounds->check[0] == dl->words.w0 && bounds->check[1] == dl->words.w1) {
+        return bounds;
+    }
+    bounds->displayList = dl;
+    bounds->check[0] = dl->words.w0;
+    bounds->check[1] = dl->words.w1;
+    bounds->radius = -1.0f;
+    if (geo_measure_display_list(dl, min, max, 0, &numCommands) && min[0] <= max[0]) {
+        vec3f_set(bounds->center, (min[0] + max[0]) / 2, (min[1] + max[1]) / 2, (min[2] + max[2]) / 2);
+        bounds->radius = sqrtf(sqr(max[0] - min[0]) + sqr(max[1] - min[1]) + sqr(max[2] - min[2])) / 2;
+    }
+    return bounds;
+}
+
+/**
+ * Whether a sphere in the space of the given matrix is at least partly inside
+ * the view frustum. The matrix goes to camera space, which looks down z-.
+ */
+static s32 geo_sphere_is_in_view(Vec3f center, f32 radius, Mat4 m) {
+    struct GraphNodePerspective *frustum = gCurGraphNodeCamFrustum;
+    f32 x = center[0] * m[0][0] + center[1] * m[1][0] + center[2] * m[2][0] + m[3][0];
+    f32 y = center[0] * m[0][1] + center[1] * m[1][1] + center[2] * m[2][1] + m[3][1];
+    f32 z = center[0] * m[0][2] + center[1] * m[1][2] + center[2] * m[2][2] + m[3][2];
+    f32 scale = 0.0f;
+    f32 halfHeight;
+    f32 halfWidth;
+
+    for (s32 i = 0; i < 3; i++) {
+        f32 len = sqr(m[i][0]) + sqr(m[i][1]) + sqr(m[i][2]);
+        if (len > scale) scale = len;
+    }
+    radius *= sqrtf(scale);
+
+    if (z > -frustum->near + radius || -z - radius > frustum->far) {
+        return FALSE;
+    }
+    // side planes pass through the camera, so compare distances along their normals
+    halfHeight = tanf(frustum->fov * (M_PI / 360.0f));
+    halfWidth = halfHeight * GFX_DIMENSIONS_ASPECT_RATIO;
+    if (x + halfWidth * z > radius * sqrtf(1.0f + sqr(halfWidth)) || -x + halfWidth * z > radius * sqrtf(1.0f + sqr(halfWidth))) {
+        return FALSE;
+    }
+    if (y + halfHeight * z > radius * sqrtf(1.0f + sqr(halfHeight)) || -y + halfHeight * z > radius * sqrtf(1.0f + sqr(halfHeight))) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static s32 geo_can_cull(void) {
+    return configFrustumCulling && gCurGraphNodeCamFrustum != NULL && !saturn_imgui_is_orthographic();
+}
+
+/**
+ * Whether a display list drawn with the top of the matrix stack can be seen.
+ * Both the interpolated and the regular matrix are drawn, so either counts.
+ */
+static s32 geo_display_list_is_in_view(Gfx *dl) {
+    struct DisplayListBounds *bounds;
+
+    if (!geo_can_cull()) {
+        return TRUE;
+    }
+    bounds = geo_get_display_list_bounds(dl);
+    return bounds->radius < 0.0f
+        || geo_sphere_is_in_view(bounds->center, bounds->radius, gMatStack[gMatStackIndex])
+        || geo_sphere_is_in_view(bounds->center, bounds->radius, gMatStackInterpolated[gMatStackIndex]);
+}
+
 /**
  * Process a translation / rotation node. A transformation matrix based
  * on the node's translation and rotation is created and pushed on both
@@ -515,7 +655,7 @@ static void geo_process_translation_rotation(struct GraphNodeTranslationRotation
     gMatStackFixed[gMatStackIndex] = mtx;
     mtxf_to_mtx(mtxInterpolated, gMatStackInterpolated[gMatStackIndex]);
     gMatStackInterpolatedFixed[gMatStackIndex] = mtxInterpolated;
-    if (node->displayList != NULL) {
+    if (node->displayList != NULL && geo_display_list_is_in_view(node->displayList)) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
     }
     if (node->node.children != NULL) {
@@ -544,7 +684,7 @@ static void geo_process_translation(struct GraphNodeTranslation *node) {
     gMatStackFixed[gMatStackIndex] = mtx;
     mtxf_to_mtx(mtxInterpolated, gMatStackInterpolated[gMatStackIndex]);
     gMatStackInterpolatedFixed[gMatStackIndex] = mtxInterpolated;
-    if (node->displayList != NULL) {
+    if (node->displayList != NULL && geo_display_list_is_in_view(node->displayList)) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
     }
     if (node->node.children != NULL) {
@@ -578,7 +718,7 @@ static void geo_process_rotation(struct GraphNodeRotation *node) {
     gMatStackFixed[gMatStackIndex] = mtx;
     mtxf_to_mtx(mtxInterpolated, gMatStackInterpolated[gMatStackIndex]);
     gMatStackInterpolatedFixed[gMatStackIndex] = mtxInterpolated;
-    if (node->displayList != NULL) {
+    if (node->displayList != NULL && geo_display_list_is_in_view(node->displayList)) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
     }
     if (node->node.children != NULL) {
@@ -604,7 +744,7 @@ static void geo_process_scale(struct GraphNodeScale *node) {
     gMatStackFixed[gMatStackIndex] = mtx;
     mtxf_to_mtx(mtxInterpolated, gMatStackInterpolated[gMatStackIndex]);
     gMatStackInterpolatedFixed[gMatStackIndex] = mtxInterpolated;
-    if (node->displayList != NULL) {
+    if (node->displayList != NULL && geo_display_list_is_in_view(node->displayList)) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
     }
     if (node->node.children != NULL) {
@@ -656,7 +796,7 @@ static void geo_process_billboard(struct GraphNodeBillboard *node) {
     gMatStackFixed[gMatStackIndex] = mtx;
     mtxf_to_mtx(mtxInterpolated, gMatStackInterpolated[gMatStackIndex]);
     gMatStackInterpolatedFixed[gMatStackIndex] = mtxInterpolated;
-    if (node->displayList != NULL) {
+    if (node->displayList != NULL && geo_display_list_is_in_view(node->displayList)) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
     }
     if (node->node.children != NULL) {
@@ -696,7 +836,7 @@ static Gfx* create_object_dl(Gfx* dl) {
  * parent node. It processes its children if it has them.
  */
 static void geo_process_display_list(struct GraphNodeDisplayList *node) {
-    if (node->displayList != NULL) {
+    if (node->displayList != NULL && geo_display_list_is_in_view(node->displayList)) {
         geo_append_display_list(create_object_dl(node->displayList), node->node.flags >> 8);
     }
     if (node->node.children != NULL) {
@@ -898,7 +1038,7 @@ static void geo_process_animated_part(struct GraphNodeAnimatedPart *node) {
     gMatStackFixed[gMatStackIndex] = matrixPtr;
     mtxf_to_mtx(mtxInterpolated, gMatStackInterpolated[gMatStackIndex]);
     gMatStackInterpolatedFixed[gMatStackIndex] = mtxInterpolated;
-    if (node->displayList != NULL) {
+    if (node->displayList != NULL && geo_display_list_is_in_view(node->displayList)) {
         geo_append_display_list(create_object_dl(node->displayList), node->node.flags >> 8);
     }
     if (node->node.children != NULL) {
@@ -915,7 +1055,7 @@ static void geo_process_mcomp_extra(struct GraphNodeAnimatedPart *node) {
     if (saturn_actor_has_custom_anim_extra()) {
         geo_process_animated_part(node);
     } else {
-        if (node->displayList != NULL) {
+        if (node->displayList != NULL && geo_display_list_is_in_view(node->displayList)) {
             geo_append_display_list(node->displayList, node->node.flags >> 8);
         }
         if (node->node.children != NULL) {
@@ -932,7 +1072,7 @@ static void geo_process_mcomp_extra(struct GraphNodeAnimatedPart *node) {
 static void geo_process_level_display_list(struct GraphNodeDisplayList *node) {
     if (autoChroma && !autoChromaLevel) return;
 
-    if (node->displayList != NULL) {
+    if (node->displayList != NULL && geo_display_list_is_in_view(node->displayList)) {
         geo_append_display_list(node->displayList, node->node.flags >> 8);
     }
     if (node->node.children != NULL) {
@@ -1106,10 +1246,10 @@ static void geo_process_shadow(struct GraphNodeShadow *node) {
 /**
  * Check whether an object is in view to determine whether it should be drawn.
  * This is known as frustum culling.
- * It checks whether the object is far away, very close / behind the camera,
- * or horizontally out of view. It does not check whether it is vertically
- * out of view. It assumes a sphere of 300 units around the object's position
- * unless the object has a culling radius node that specifies otherwise.
+ * Objects with a culling radius node are tested as a sphere of that radius
+ * around the object's position, scaled along with the object. Objects without
+ * one are always processed, and their display lists are culled one by one
+ * using the bounds measured by geo_display_list_is_in_view.
  *
  * The matrix parameter should be the top of the matrix stack, which is the
  * object's transformation matrix times the camera 'look-at' matrix. The math
@@ -1132,10 +1272,22 @@ static void geo_process_shadow(struct GraphNodeShadow *node) {
  *       \|/
  *        C       x+
  *
- * Since (0,0,0) is unaffected by rotation, columns 0, 1 and 2 are ignored.
+ * Since (0,0,0) is unaffected by rotation, columns 0, 1 and 2 only matter for
+ * how much they scale the radius.
  */
 static int obj_is_in_view(struct GraphNodeObject *node, Mat4 matrix) {
-    return !(node->node.flags & GRAPH_RENDER_INVISIBLE);
+    struct GraphNode *geo = node->sharedChild;
+    s16 cullingRadius;
+
+    if (node->node.flags & GRAPH_RENDER_INVISIBLE) {
+        return FALSE;
+    }
+    if (!geo_can_cull() || geo == NULL || geo->type != GRAPH_NODE_TYPE_CULLING_RADIUS) {
+        return TRUE;
+    }
+    cullingRadius = ((struct GraphNodeCullingRadius *) geo)->cullingRadius;
+    return geo_sphere_is_in_view(gVec3fZero, cullingRadius, matrix)
+        || geo_sphere_is_in_view(gVec3fZero, cullingRadius, gMatStackInterpolated[gMatStackIndex]);
 }
 
 static void interpolate_matrix(Mat4 result, Mat4 a, Mat4 b) {
@@ -23,6 +23,12 @@ static void print_help(void) {
     printf("%-20s\tSkips the Peach and Castle intro when starting a new game.\n", "--skip-intro");
     printf("%-20s\tStarts the game in windowed mode.\n", "--windowed");
     printf("%-20s\tOnly extracts the assets, then quit.\n", "--only-extract");
+    printf("%-20s\tRenders PROJECT without showing a window, then quit.\n", "--render PROJECT");
+    printf("%-20s\tSets the output file of --render, the extension picks the format.\n", "--out FILE");
+    printf("%-20s\tSets the resolution of --render (default 1920x1080).\n", "--res WxH");
+    printf("%-20s\tSets the framerate of --render, 30 or 60 (default 30).\n", "--fps FPS");
+    printf("%-20s\tSplits --render into chunks of FRAMES frames that can be resumed.\n", "--chunk-frames FRAMES");
+    printf("%-20s\tOnly renders chunk N (starting at 1), to split a render across processes.\n", "--chunk N");
 }
 
 static inline int arg_string(const char *name, const char *value, char *target) {
@@ -42,7 +48,19 @@ static inline int arg_uint(UNUSED const char *name, const char *value, unsigned
     return 1;
 }
 
-void parse_cli_opts(int argc, char* argv[]) {
+static inline int arg_res(const char *name, const char *value, unsigned int *w, unsigned int *h) {
+    if (sscanf(value, "%ux%u", w, h) != 2 || *w == 0 || *h == 0) {
+        fprintf(stderr, "Supplied value for `%s` is not a resolution.\n", name);
+        *w = *h = 0;
+        return 0;
+    }
+    return 1;
+}
+
+// Returns false if a --render option couldn't be parsed
+bool parse_cli_opts(int argc, char* argv[]) {
+    bool valid = true;
+
     // Initialize options with false values.
     memset(&gCLIOpts, 0, sizeof(gCLIOpts));
 
@@ -77,10 +95,35 @@ void parse_cli_opts(int argc, char* argv[]) {
         else if (strcmp(argv[i], "--only-extract") == 0) // Only extracts the assets, then quit
             gCLIOpts.ExtractOnly = 1;
 
+        else if (strcmp(argv[i], "--render") == 0 && (i + 1) < argc) // Headless project render
+            valid &= arg_string("--render", argv[++i], gCLIOpts.RenderProject);
+
+        else if (strcmp(argv[i], "--out") == 0 && (i + 1) < argc)
+            valid &= arg_string("--out", argv[++i], gCLIOpts.RenderOutput);
+
+        else if (strcmp(argv[i], "--res") == 0 && (i + 1) < argc)
+            valid &= arg_res("--res", argv[++i], &gCLIOpts.RenderWidth, &gCLIOpts.RenderHeight);
+
+        else if (strcmp(argv[i], "--fps") == 0 && (i + 1) < argc)
+            arg_uint("--fps", argv[++i], &gCLIOpts.RenderFps);
+
+        else if (strcmp(argv[i], "--chunk-frames") == 0 && (i + 1) < argc)
+            arg_uint("--chunk-frames", argv[++i], &gCLIOpts.RenderChunkFrames);
+
+        else if (strcmp(argv[i], "--chunk") == 0 && (i + 1) < argc) {
+            arg_uint("--chunk", argv[++i], &gCLIOpts.RenderChunk);
+            if (gCLIOpts.RenderChunk == 0) {
+                fprintf(stderr, "Chunks given to `--chunk` start at 1.\n");
+                valid = false;
+            }
+        }
+
         // Print help
         else if (strcmp(argv[i], "--help") == 0) {
             print_help();
             game_exit();
         }
     }
+
+    return valid;
 }
@@ -12,10 +12,17 @@ struct PCCLIOptions  {
     char ConfigFile[SYS_MAX_PATH];
     char SavePath[SYS_MAX_PATH];
     char GameDir[SYS_MAX_PATH];
+    char RenderProject[SYS_MAX_PATH];
+    char RenderOutput[SYS_MAX_PATH];
+    unsigned int RenderWidth;
+    unsigned int RenderHeight;
+    unsigned int RenderFps;
+    unsigned int RenderChunk;
+    unsigned int RenderChunkFrames;
 };
 
 extern struct PCCLIOptions gCLIOpts;
 
-void parse_cli_opts(int argc, char* argv[]);
+bool parse_cli_opts(int argc, char* argv[]);
 
 #endif // _CLIOPTS_H
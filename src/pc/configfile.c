@@ -112,6 +112,22 @@ unsigned int configEditorTextures = 0;
 float        camera_fov = 50.0f;
 unsigned int configWorldsimSteps = 10;
 bool         configEnableShipBug = false;
+unsigned int configCapturePboRing = 3;
+unsigned int configCaptureQueueDepth = 4;
+unsigned int configPngCompression = 8;
+bool         configOfflineRender = true;
+bool         configCaptureAudio = true;
+unsigned int configMotionBlurSamples = 1;
+unsigned int configRenderChunkFrames = 0;
+bool         configBatchOpaque = false;
+bool         configThreadedGfx = false;
+bool         configUberShader = false;
+bool         configFrustumCulling = true;
+unsigned int configTextureCacheBudget = 1024; // in MiB, 0 for no limit
+bool         configTextureStreaming = true;
+unsigned int configTextureUploadBudget = 4; // in ms per frame
+bool         configTextureStreamBlockCapture = true;
+bool         configTexturePackCache = true;
 #ifdef BETTERCAMERA
 // BetterCamera settings
 unsigned int configCameraXSens   = 50;
@@ -222,6 +238,22 @@ static const struct ConfigOption options[] = {
     {.name = "default_fov", .type = CONFIG_TYPE_FLOAT, .floatValue = &camera_fov},
     {.name = "worldsim_steps", .type = CONFIG_TYPE_UINT, .uintValue = &configWorldsimSteps},
     {.name = "ship_bug", .type = CONFIG_TYPE_BOOL, .boolValue = &configEnableShipBug},
+    {.name = "capture_pbo_ring", .type = CONFIG_TYPE_UINT, .uintValue = &configCapturePboRing},
+    {.name = "capture_queue_depth", .type = CONFIG_TYPE_UINT, .uintValue = &configCaptureQueueDepth},
+    {.name = "png_compression", .type = CONFIG_TYPE_UINT, .uintValue = &configPngCompression},
+    {.name = "offline_render", .type = CONFIG_TYPE_BOOL, .boolValue = &configOfflineRender},
+    {.name = "capture_audio", .type = CONFIG_TYPE_BOOL, .boolValue = &configCaptureAudio},
+    {.name = "motion_blur_samples", .type = CONFIG_TYPE_UINT, .uintValue = &configMotionBlurSamples},
+    {.name = "render_chunk_frames", .type = CONFIG_TYPE_UINT, .uintValue = &configRenderChunkFrames},
+    {.name = "batch_opaque", .type = CONFIG_TYPE_BOOL, .boolValue = &configBatchOpaque},
+    {.name = "threaded_gfx", .type = CONFIG_TYPE_BOOL, .boolValue = &configThreadedGfx},
+    {.name = "uber_shader", .type = CONFIG_TYPE_BOOL, .boolValue = &configUberShader},
+    {.name = "frustum_culling", .type = CONFIG_TYPE_BOOL, .boolValue = &configFrustumCulling},
+    {.name = "texture_cache_budget", .type = CONFIG_TYPE_UINT, .uintValue = &configTextureCacheBudget},
+    {.name = "texture_streaming", .type = CONFIG_TYPE_BOOL, .boolValue = &configTextureStreaming},
+    {.name = "texture_upload_budget", .type = CONFIG_TYPE_UINT, .uintValue = &configTextureUploadBudget},
+    {.name = "texture_stream_block_capture", .type = CONFIG_TYPE_BOOL, .boolValue = &configTextureStreamBlockCapture},
+    {.name = "texture_pack_cache", .type = CONFIG_TYPE_BOOL, .boolValue = &configTexturePackCache},
     #ifdef BETTERCAMERA
     {.name = "bettercam_enable",     .type = CONFIG_TYPE_BOOL, .boolValue = &configEnableCamera},
     {.name = "bettercam_analog",     .type = CONFIG_TYPE_BOOL, .boolValue = &configCameraAnalog},
@@ -78,6 +78,22 @@ extern float        camera_fov;
 extern bool         configUnstableFeatures;
 extern unsigned int configWorldsimSteps;
 extern bool         configEnableShipBug;
+extern unsigned int configCapturePboRing;
+extern unsigned int configCaptureQueueDepth;
+extern unsigned int configPngCompression;
+extern bool         configOfflineRender;
+extern bool         configCaptureAudio;
+extern unsigned int configMotionBlurSamples;
+extern unsigned int configRenderChunkFrames;
+extern bool         configBatchOpaque;
+extern bool         configThreadedGfx;
+extern bool         configUberShader;
+extern bool         configFrustumCulling;
+extern unsigned int configTextureCacheBudget;
+extern bool         configTextureStreaming;
+extern unsigned int configTextureUploadBudget;
+extern bool         configTextureStreamBlockCapture;
+extern bool         configTexturePackCache;
 #ifdef BETTERCAMERA
 extern unsigned int configCameraXSens;
 extern unsigned int configCameraYSens;
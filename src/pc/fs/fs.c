@@ -234,6 +234,11 @@ int64_t fs_size(fs_file_t *file) {
     return file->parent->packer->size(file->parent->pack, file);
 }
 
+int64_t fs_mtime(fs_file_t *file) {
+    if (!file) return -1;
+    return file->parent->packer->mtime(file->parent->pack, file);
+}
+
 bool fs_eof(fs_file_t *file) {
     if (!file) return true;
     return file->parent->packer->eof(file->parent->pack, file);
@@ -74,6 +74,7 @@ typedef struct {
     bool (*seek)(void *pack, fs_file_t *file, const int64_t ofs); // returns true if seek succeeded
     int64_t (*tell)(void *pack, fs_file_t *file); // returns -1 in case of error, current virtual file position otherwise
     int64_t (*size)(void *pack, fs_file_t *file); // returns -1 in case of error, size of the (uncompressed) file otherwise
+    int64_t (*mtime)(void *pack, fs_file_t *file); // returns -1 in case of error, modification time of the file (or the archive it's in) otherwise
     bool (*eof)(void *pack, fs_file_t *file);     // returns true if there's nothing more to read
     void (*close)(void *pack, fs_file_t *file);   // closes a virtual file previously opened with ->open()
 } fs_packtype_t;
@@ -111,6 +112,7 @@ const char *fs_readline(fs_file_t *file, char *dst, const uint64_t size);
 bool fs_seek(fs_file_t *file, const int64_t ofs);
 int64_t fs_tell(fs_file_t *file);
 int64_t fs_size(fs_file_t *file);
+int64_t fs_mtime(fs_file_t *file);
 bool fs_eof(fs_file_t *file);
 
 void *fs_load_file(const char *vpath, uint64_t *outsize);
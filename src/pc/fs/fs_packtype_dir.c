@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <sys/stat.h>
 
 #include "macros.h"
 #include "../platform.h"
@@ -96,6 +97,12 @@ static int64_t pack_dir_size(UNUSED void *pack, fs_file_t *file) {
     return size;
 }
 
+static int64_t pack_dir_mtime(UNUSED void *pack, fs_file_t *file) {
+    struct stat st;
+    if (fstat(fileno((FILE *)file->handle), &st) != 0) return -1;
+    return (int64_t)st.st_mtime;
+}
+
 static bool pack_dir_eof(UNUSED void *pack, fs_file_t *file) {
     return feof((FILE *)file->handle);
 }
@@ -112,6 +119,7 @@ fs_packtype_t fs_packtype_dir = {
     pack_dir_seek,
     pack_dir_tell,
     pack_dir_size,
+    pack_dir_mtime,
     pack_dir_eof,
     pack_dir_close,
 };
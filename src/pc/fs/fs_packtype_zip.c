@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include <tinfl.h>
 
@@ -464,6 +465,13 @@ static int64_t pack_zip_size(UNUSED void *pack, fs_file_t *file) {
     return zipfile->entry->uncomp_size;
 }
 
+static int64_t pack_zip_mtime(void *pack, UNUSED fs_file_t *file) {
+    // entries can't change without the archive changing
+    struct stat st;
+    if (stat(((zip_pack_t *)pack)->realpath, &st) != 0) return -1;
+    return (int64_t)st.st_mtime;
+}
+
 static bool pack_zip_eof(UNUSED void *pack, fs_file_t *file) {
     zip_file_t *zipfile = (zip_file_t *)file->handle;
     return zipfile->uncomp_pos >= zipfile->entry->uncomp_size;
@@ -481,6 +489,7 @@ fs_packtype_t fs_packtype_zip = {
     pack_zip_seek,
     pack_zip_tell,
     pack_zip_size,
+    pack_zip_mtime,
     pack_zip_eof,
     pack_zip_close,
 };
@@ -41,6 +41,10 @@
 
 #define DEBUG_D3D 0
 
+// Room for 8 full batches (4096 triangles, same as buf_vbo in gfx_pc) per vertex buffer,
+// more buffers are created if a frame needs them
+#define VERTEX_BUFFER_SIZE (8 * 4096 * 26 * 3 * sizeof(float))
+
 using namespace Microsoft::WRL; // For ComPtr
 
 namespace {
@@ -148,9 +152,11 @@ static struct {
     void *mapped_noise_cb_address;
     struct NoiseCB noise_cb_data;
     
-    ComPtr<ID3D12Resource> vertex_buffer;
-    void *mapped_vbuf_address;
-    int vbuf_pos;
+    // Upload buffers vertices are copied to, only reused once the frame's been waited for in finish_render
+    std::vector<ComPtr<ID3D12Resource>> vertex_buffers;
+    std::vector<void *> mapped_vbuf_addresses;
+    size_t vbuf_index;
+    size_t vbuf_pos;
     
     std::vector<ComPtr<ID3D12Resource>> resources_to_clean_at_end_of_frame;
     std::vector<std::pair<struct TextureHeap *, uint8_t>> texture_heap_allocations_to_reclaim_at_end_of_frame;
@@ -448,6 +454,27 @@ static void gfx_direct3d12_set_use_alpha(bool use_alpha) {
     // Already part of the pipeline state from shader info
 }
 
+static void create_vertex_buffer(void) {
+    ComPtr<ID3D12Resource> vertex_buffer;
+    void *mapped_address;
+    
+    CD3DX12_HEAP_PROPERTIES hp(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC rdb = CD3DX12_RESOURCE_DESC::Buffer(VERTEX_BUFFER_SIZE);
+    ThrowIfFailed(d3d.device->CreateCommittedResource(
+        &hp,
+        D3D12_HEAP_FLAG_NONE,
+        &rdb,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&vertex_buffer)));
+    
+    CD3DX12_RANGE read_range(0, 0); // Read not possible from CPU
+    ThrowIfFailed(vertex_buffer->Map(0, &read_range, &mapped_address));
+    
+    d3d.vertex_buffers.push_back(vertex_buffer);
+    d3d.mapped_vbuf_addresses.push_back(mapped_address);
+}
+
 static void gfx_direct3d12_draw_triangles(float buf_vbo[], size_t buf_vbo_len, size_t buf_vbo_num_tris) {
     struct ShaderProgramD3D12 *prg = d3d.shader_program;
     
@@ -562,17 +589,21 @@ static void gfx_direct3d12_draw_triangles(float buf_vbo[], size_t buf_vbo_len, s
     d3d.command_list->RSSetViewports(1, &d3d.viewport);
     d3d.command_list->RSSetScissorRects(1, &d3d.scissor);
     
-    int current_pos = d3d.vbuf_pos;
-    memcpy((uint8_t *)d3d.mapped_vbuf_address + current_pos, buf_vbo, buf_vbo_len * sizeof(float));
-    d3d.vbuf_pos += buf_vbo_len * sizeof(float);
-    static int maxpos;
-    if (d3d.vbuf_pos > maxpos) {
-        maxpos = d3d.vbuf_pos;
-        //printf("NEW MAXPOS: %d\n", maxpos);
+    size_t size = buf_vbo_len * sizeof(float);
+    if (d3d.vbuf_pos + size > VERTEX_BUFFER_SIZE) {
+        // Full, move on to the next buffer
+        d3d.vbuf_index++;
+        d3d.vbuf_pos = 0;
+        if (d3d.vbuf_index == d3d.vertex_buffers.size()) {
+            create_vertex_buffer();
+        }
     }
+    size_t current_pos = d3d.vbuf_pos;
+    memcpy((uint8_t *)d3d.mapped_vbuf_addresses[d3d.vbuf_index] + current_pos, buf_vbo, size);
+    d3d.vbuf_pos += size;
     
     D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view;
-    vertex_buffer_view.BufferLocation = d3d.vertex_buffer->GetGPUVirtualAddress() + current_pos;
+    vertex_buffer_view.BufferLocation = d3d.vertex_buffers[d3d.vbuf_index]->GetGPUVirtualAddress() + current_pos;
     vertex_buffer_view.StrideInBytes = buf_vbo_len / (3 * buf_vbo_num_tris) * sizeof(float);
     vertex_buffer_view.SizeInBytes = buf_vbo_len * sizeof(float);
     
@@ -613,6 +644,7 @@ static void gfx_direct3d12_start_frame(void) {
     d3d.noise_cb_data.noise_scale_y = 120;
     memcpy(d3d.mapped_noise_cb_address, &d3d.noise_cb_data, sizeof(struct NoiseCB));
     
+    d3d.vbuf_index = 0;
     d3d.vbuf_pos = 0;
 }
 
@@ -851,21 +883,7 @@ static void gfx_direct3d12_init(void ) {
     
     ThrowIfFailed(d3d.device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&d3d.copy_fence)));
     
-    {
-        // Create a buffer of 1 MB in size. With a 120 star speed run 192 kB seems to be max usage.
-        CD3DX12_HEAP_PROPERTIES hp(D3D12_HEAP_TYPE_UPLOAD);
-        CD3DX12_RESOURCE_DESC rdb = CD3DX12_RESOURCE_DESC::Buffer(256 * 1024 * sizeof(float));
-        ThrowIfFailed(d3d.device->CreateCommittedResource(
-            &hp,
-            D3D12_HEAP_FLAG_NONE,
-            &rdb,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&d3d.vertex_buffer)));
-        
-        CD3DX12_RANGE read_range(0, 0); // Read not possible from CPU
-        ThrowIfFailed(d3d.vertex_buffer->Map(0, &read_range, &d3d.mapped_vbuf_address));
-    }
+    create_vertex_buffer();
 }
 
 static void gfx_direct3d12_end_frame(void) {
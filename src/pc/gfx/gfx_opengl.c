@@ -37,14 +37,17 @@
 
 #include "../platform.h"
 #include "../configfile.h"
+#include "../fs/fs.h"
 #include "gfx_pc.h"
 #include "gfx_cc.h"
 #include "gfx_rendering_api.h"
+#include "gfx_opengl.h"
 
 #include "src/saturn/saturn.h"
 #include "src/saturn/imgui/saturn_imgui.h"
 
 #define TEX_CACHE_STEP 512
+#define SHADER_POOL_STEP 64
 
 struct ShaderProgram {
     uint32_t shader_id;
@@ -53,10 +56,13 @@ struct ShaderProgram {
     bool used_textures[2];
     uint8_t num_floats;
     GLint attrib_locations[7];
-    GLint uniform_locations[5];
+    GLint uniform_locations[7];
     uint8_t attrib_sizes[7];
     uint8_t num_attribs;
     bool used_noise;
+    bool uber;
+    bool shared_program;
+    uint8_t combiner[2][4];
 };
 
 struct GLTexture {
@@ -65,8 +71,9 @@ struct GLTexture {
     bool filter;
 };
 
-static struct ShaderProgram shader_program_pool[64];
-static uint8_t shader_program_pool_size;
+static struct ShaderProgram **shader_program_pool;
+static size_t shader_program_pool_size;
+static size_t shader_program_pool_cap;
 static GLuint opengl_vbo;
 
 static int tex_cache_size = 0;
@@ -79,6 +86,23 @@ static int opengl_curtex = 0;
 
 static uint32_t frame_count;
 
+// combiners picked through uniforms instead of one program each, decided at init
+static bool use_uber_shader;
+
+// What's actually bound, so switching between combiners that share a program
+// only sets their uniforms instead of binding it and its attributes again
+static GLuint opengl_bound_program;
+static struct ShaderProgram *opengl_attrib_prg; // whose attributes are enabled
+static struct ShaderProgram *opengl_combiner_prg; // whose combiner is in the bound uber program
+
+// counted over a frame, shown in the settings
+static int shader_loads, program_binds, last_shader_loads, last_program_binds;
+
+static bool gl_has_extension(const char *name) {
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+    return extensions && strstr(extensions, name);
+}
+
 static bool gfx_opengl_z_is_from_0_to_1(void) {
     return false;
 }
@@ -106,24 +130,54 @@ static inline void gfx_opengl_set_texture_uniforms(struct ShaderProgram *prg, co
     }
 }
 
+// Disables the enabled attributes and forgets the bound program, for code that binds its own
+static void gfx_opengl_release_program(void) {
+    if (opengl_attrib_prg != NULL) {
+        for (int i = 0; i < opengl_attrib_prg->num_attribs; i++)
+            glDisableVertexAttribArray(opengl_attrib_prg->attrib_locations[i]);
+    }
+    opengl_attrib_prg = NULL;
+    opengl_combiner_prg = NULL;
+    opengl_bound_program = 0;
+}
+
 static void gfx_opengl_unload_shader(struct ShaderProgram *old_prg) {
-    if (old_prg != NULL) {
-        for (int i = 0; i < old_prg->num_attribs; i++)
-            glDisableVertexAttribArray(old_prg->attrib_locations[i]);
-        if (old_prg == opengl_prg)
-            opengl_prg = NULL;
-    } else {
+    // attributes are left enabled, the next load decides if they need to change
+    if (old_prg == NULL || old_prg == opengl_prg)
         opengl_prg = NULL;
-    }
 }
 
 static void gfx_opengl_load_shader(struct ShaderProgram *new_prg) {
     opengl_prg = new_prg;
-    glUseProgram(new_prg->opengl_program_id);
-    gfx_opengl_vertex_array_set_attribs(new_prg);
+    shader_loads++;
+    if (new_prg->opengl_program_id != opengl_bound_program) {
+        glUseProgram(new_prg->opengl_program_id);
+        opengl_bound_program = new_prg->opengl_program_id;
+        opengl_combiner_prg = NULL;
+        program_binds++;
+    }
+    // programs sharing a GL program have the same vertex layout, so their attributes stay as they are
+    if (opengl_attrib_prg == NULL || opengl_attrib_prg->opengl_program_id != new_prg->opengl_program_id) {
+        if (opengl_attrib_prg != NULL) {
+            for (int i = 0; i < opengl_attrib_prg->num_attribs; i++)
+                glDisableVertexAttribArray(opengl_attrib_prg->attrib_locations[i]);
+        }
+        gfx_opengl_vertex_array_set_attribs(new_prg);
+    }
+    opengl_attrib_prg = new_prg;
     gfx_opengl_set_shader_uniforms(new_prg);
     gfx_opengl_set_texture_uniforms(new_prg, 0);
     gfx_opengl_set_texture_uniforms(new_prg, 1);
+    if (new_prg->uber && (opengl_combiner_prg == NULL || memcmp(opengl_combiner_prg->combiner, new_prg->combiner, sizeof(new_prg->combiner)))) {
+        glUniform4i(new_prg->uniform_locations[5], new_prg->combiner[0][0], new_prg->combiner[0][1], new_prg->combiner[0][2], new_prg->combiner[0][3]);
+        glUniform4i(new_prg->uniform_locations[6], new_prg->combiner[1][0], new_prg->combiner[1][1], new_prg->combiner[1][2], new_prg->combiner[1][3]);
+        opengl_combiner_prg = new_prg;
+    }
+}
+
+void gfx_opengl_get_shader_stats(int *loads, int *binds) {
+    *loads = last_shader_loads;
+    *binds = last_program_binds;
 }
 
 static void append_str(char *buf, size_t *len, const char *str) {
@@ -205,6 +259,177 @@ static void append_formula(char *buf, size_t *len, uint8_t c[2][4], bool do_sing
     }
 }
 
+// Shader program cache
+// Linked programs are saved with glGetProgramBinary so combiners seen in an
+// earlier session don't have to be compiled again. The file is only valid for
+// the driver that wrote it, and everything in it is loaded at startup.
+
+#define SHADER_CACHE_FILE "shader_cache.bin"
+#define SHADER_CACHE_MAGIC "SATSHDR1"
+
+struct ShaderCacheEntry {
+    uint32_t shader_id;
+    uint32_t format;
+    uint32_t length;
+    void *binary;
+};
+
+static bool shader_cache_enabled;
+static bool shader_cache_stale;
+static struct ShaderCacheEntry *shader_cache;
+static size_t shader_cache_count;
+
+static void gfx_opengl_shader_cache_identity(char *buf, size_t size) {
+    const char *vendor = (const char *)glGetString(GL_VENDOR);
+    const char *renderer = (const char *)glGetString(GL_RENDERER);
+    const char *version = (const char *)glGetString(GL_VERSION);
+    snprintf(buf, size, "%s\n%s\n%s%s", vendor ? vendor : "", renderer ? renderer : "", version ? version : "",
+        use_uber_shader ? "\nuber" : "");
+}
+
+// reads every entry of the cache file, returns false if it's missing or from another driver
+static bool gfx_opengl_shader_cache_read(const char *identity) {
+    FILE *f = fopen(fs_get_write_path(SHADER_CACHE_FILE), "rb");
+    if (!f) return false;
+
+    char magic[8];
+    char file_identity[1024];
+    uint32_t len;
+    bool valid = fread(magic, sizeof(magic), 1, f) == 1 && !memcmp(magic, SHADER_CACHE_MAGIC, sizeof(magic))
+        && fread(&len, sizeof(len), 1, f) == 1 && len == strlen(identity) && len < sizeof(file_identity)
+        && fread(file_identity, len, 1, f) == 1 && !memcmp(file_identity, identity, len);
+
+    uint32_t header[3];
+    while (valid && fread(header, sizeof(header), 1, f) == 1) {
+        void *binary = malloc(header[2]);
+        if (!binary || fread(binary, header[2], 1, f) != 1) {
+            // truncated, keep what was read so far
+            free(binary);
+            shader_cache_stale = true;
+            break;
+        }
+        shader_cache = realloc(shader_cache, sizeof(struct ShaderCacheEntry) * (shader_cache_count + 1));
+        if (!shader_cache) sys_fatal("out of memory loading shader cache");
+        shader_cache[shader_cache_count++] = (struct ShaderCacheEntry) { header[0], header[1], header[2], binary };
+    }
+
+    fclose(f);
+    return valid;
+}
+
+static GLuint gfx_opengl_shader_cache_load(uint32_t shader_id) {
+#ifndef USE_GLES
+    for (size_t i = 0; i < shader_cache_count; i++) {
+        struct ShaderCacheEntry *entry = &shader_cache[i];
+        if (entry->shader_id != shader_id) continue;
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, entry->format, entry->binary, entry->length);
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (success) return program;
+        // the driver changed without saying so, this one gets compiled again
+        glDeleteProgram(program);
+        shader_cache_stale = true;
+    }
+#endif
+    return 0;
+}
+
+static void gfx_opengl_shader_cache_save(struct ShaderProgram *prg) {
+#ifndef USE_GLES
+    if (!shader_cache_enabled || prg->shared_program) return;
+
+    GLint length = 0;
+    glGetProgramiv(prg->opengl_program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    void *binary = malloc(length);
+    if (!binary) return;
+
+    GLenum format;
+    GLsizei written = 0;
+    glGetProgramBinary(prg->opengl_program_id, length, &written, &format, binary);
+    FILE *f = written > 0 ? fopen(fs_get_write_path(SHADER_CACHE_FILE), "ab") : NULL;
+    if (f) {
+        uint32_t header[3] = { prg->shader_id, format, written };
+        fwrite(header, sizeof(header), 1, f);
+        fwrite(binary, written, 1, f);
+        fclose(f);
+    }
+    free(binary);
+#endif
+}
+
+static struct ShaderProgram *gfx_opengl_alloc_shader(void) {
+    if (shader_program_pool_size >= shader_program_pool_cap) {
+        shader_program_pool_cap += SHADER_POOL_STEP;
+        shader_program_pool = realloc(shader_program_pool, sizeof(struct ShaderProgram *) * shader_program_pool_cap);
+        if (!shader_program_pool) sys_fatal("out of memory allocating shader pool");
+    }
+    // programs are handed out by pointer, so they're allocated one by one
+    struct ShaderProgram *prg = calloc(1, sizeof(struct ShaderProgram));
+    if (!prg) sys_fatal("out of memory allocating shader program");
+    return shader_program_pool[shader_program_pool_size++] = prg;
+}
+
+// uber shader programs only differ in what goes into the vertex buffer and the option bits
+static uint32_t gfx_opengl_uber_key(uint32_t shader_id, const bool used_textures[2], int num_inputs) {
+    return (shader_id & 0xff000000) | used_textures[0] | (used_textures[1] << 1) | (num_inputs << 2);
+}
+
+static struct ShaderProgram *gfx_opengl_lookup_uber_program(uint32_t key) {
+    for (size_t i = 0; i < shader_program_pool_size; i++) {
+        struct ShaderProgram *prg = shader_program_pool[i];
+        if (prg->uber && gfx_opengl_uber_key(prg->shader_id, prg->used_textures, prg->num_inputs) == key) {
+            return prg;
+        }
+    }
+    return NULL;
+}
+
+static GLuint gfx_opengl_compile_program(const char *vs_buf, GLint vs_len, const char *fs_buf, GLint fs_len) {
+    const GLchar *sources[2] = { vs_buf, fs_buf };
+    const GLint lengths[2] = { vs_len, fs_len };
+    GLint success;
+
+    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex_shader, 1, &sources[0], &lengths[0]);
+    glCompileShader(vertex_shader);
+    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        GLint max_length = 0;
+        glGetShaderiv(vertex_shader, GL_INFO_LOG_LENGTH, &max_length);
+        char error_log[1024];
+        fprintf(stderr, "Vertex shader compilation failed\n");
+        glGetShaderInfoLog(vertex_shader, max_length, &max_length, &error_log[0]);
+        fprintf(stderr, "%s\n", &error_log[0]);
+        sys_fatal("vertex shader compilation failed (see terminal)");
+    }
+
+    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment_shader, 1, &sources[1], &lengths[1]);
+    glCompileShader(fragment_shader);
+    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        GLint max_length = 0;
+        glGetShaderiv(fragment_shader, GL_INFO_LOG_LENGTH, &max_length);
+        char error_log[1024];
+        fprintf(stderr, "Fragment shader compilation failed\n");
+        glGetShaderInfoLog(fragment_shader, max_length, &max_length, &error_log[0]);
+        fprintf(stderr, "%s\n", &error_log[0]);
+        sys_fatal("fragment shader compilation failed (see terminal)");
+    }
+
+    GLuint shader_program = glCreateProgram();
+    glAttachShader(shader_program, vertex_shader);
+    glAttachShader(shader_program, fragment_shader);
+#ifndef USE_GLES
+    if (shader_cache_enabled)
+        glProgramParameteri(shader_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+    glLinkProgram(shader_program);
+    return shader_program;
+}
+
 static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shader_id) {
     uint8_t c[2][4];
     for (int i = 0; i < 4; i++) {
@@ -243,7 +468,7 @@ static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shad
     bool color_alpha_same = (shader_id & 0xfff) == ((shader_id >> 12) & 0xfff);
 
     char vs_buf[1024];
-    char fs_buf[2048];
+    char fs_buf[4096];
     size_t vs_len = 0;
     size_t fs_len = 0;
     size_t num_floats = 4;
@@ -348,6 +573,27 @@ static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shad
         append_line(fs_buf, &fs_len, "}");
     }
 
+    if (use_uber_shader) {
+        append_line(fs_buf, &fs_len, "uniform ivec4 uColorCombiner;");
+        append_line(fs_buf, &fs_len, "uniform ivec4 uAlphaCombiner;");
+        append_line(fs_buf, &fs_len, "vec4 ccInput(in int item, in vec4 tex0, in vec4 tex1) {");
+        for (int i = 0; i < num_inputs; i++) {
+            if (opt_alpha) {
+                fs_len += sprintf(fs_buf + fs_len, "if (item == %d) return vInput%d;\n", SHADER_INPUT_1 + i, i + 1);
+            } else {
+                fs_len += sprintf(fs_buf + fs_len, "if (item == %d) return vec4(vInput%d, 1.0);\n", SHADER_INPUT_1 + i, i + 1);
+            }
+        }
+        fs_len += sprintf(fs_buf + fs_len, "if (item == %d) return tex0;\n", SHADER_TEXEL0);
+        fs_len += sprintf(fs_buf + fs_len, "if (item == %d) return vec4(tex0.a);\n", SHADER_TEXEL0A);
+        fs_len += sprintf(fs_buf + fs_len, "if (item == %d) return tex1;\n", SHADER_TEXEL1);
+        append_line(fs_buf, &fs_len, "return vec4(0.0);");
+        append_line(fs_buf, &fs_len, "}");
+        append_line(fs_buf, &fs_len, "vec4 ccFormula(in ivec4 c, in vec4 tex0, in vec4 tex1) {");
+        append_line(fs_buf, &fs_len, "return (ccInput(c.x, tex0, tex1) - ccInput(c.y, tex0, tex1)) * ccInput(c.z, tex0, tex1) + ccInput(c.w, tex0, tex1);");
+        append_line(fs_buf, &fs_len, "}");
+    }
+
     append_line(fs_buf, &fs_len, "void main() {");
 
     if (used_textures[0]) {
@@ -357,17 +603,27 @@ static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shad
         append_line(fs_buf, &fs_len, "vec4 texVal1 = sampleTex(uTex1, vTexCoord, uTex1Size, uTex1Filter);");
     }
 
-    append_str(fs_buf, &fs_len, opt_alpha ? "vec4 texel = " : "vec3 texel = ");
-    if (!color_alpha_same && opt_alpha) {
-        append_str(fs_buf, &fs_len, "vec4(");
-        append_formula(fs_buf, &fs_len, c, do_single[0], do_multiply[0], do_mix[0], false, false, true);
-        append_str(fs_buf, &fs_len, ", ");
-        append_formula(fs_buf, &fs_len, c, do_single[1], do_multiply[1], do_mix[1], true, true, true);
-        append_str(fs_buf, &fs_len, ")");
+    if (use_uber_shader) {
+        const char *tex0 = used_textures[0] ? "texVal0" : "vec4(0.0)";
+        const char *tex1 = used_textures[1] ? "texVal1" : "vec4(0.0)";
+        if (opt_alpha) {
+            fs_len += sprintf(fs_buf + fs_len, "vec4 texel = vec4(ccFormula(uColorCombiner, %s, %s).rgb, ccFormula(uAlphaCombiner, %s, %s).a);\n", tex0, tex1, tex0, tex1);
+        } else {
+            fs_len += sprintf(fs_buf + fs_len, "vec3 texel = ccFormula(uColorCombiner, %s, %s).rgb;\n", tex0, tex1);
+        }
     } else {
-        append_formula(fs_buf, &fs_len, c, do_single[0], do_multiply[0], do_mix[0], opt_alpha, false, opt_alpha);
+        append_str(fs_buf, &fs_len, opt_alpha ? "vec4 texel = " : "vec3 texel = ");
+        if (!color_alpha_same && opt_alpha) {
+            append_str(fs_buf, &fs_len, "vec4(");
+            append_formula(fs_buf, &fs_len, c, do_single[0], do_multiply[0], do_mix[0], false, false, true);
+            append_str(fs_buf, &fs_len, ", ");
+            append_formula(fs_buf, &fs_len, c, do_single[1], do_multiply[1], do_mix[1], true, true, true);
+            append_str(fs_buf, &fs_len, ")");
+        } else {
+            append_formula(fs_buf, &fs_len, c, do_single[0], do_multiply[0], do_mix[0], opt_alpha, false, opt_alpha);
+        }
+        append_line(fs_buf, &fs_len, ";");
     }
-    append_line(fs_buf, &fs_len, ";");
 
     if (opt_texture_edge && opt_alpha) {
         append_line(fs_buf, &fs_len, "if (texel.a > 0.3) texel.a = 1.0; else discard;");
@@ -400,46 +656,19 @@ static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shad
     puts(fs_buf);
     puts("End");*/
 
-    const GLchar *sources[2] = { vs_buf, fs_buf };
-    const GLint lengths[2] = { vs_len, fs_len };
-    GLint success;
+    // with the uber shader, combiners with the same vertex layout and options share a program
+    struct ShaderProgram *uber_prg = NULL;
+    if (use_uber_shader)
+        uber_prg = gfx_opengl_lookup_uber_program(gfx_opengl_uber_key(shader_id, used_textures, num_inputs));
 
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &sources[0], &lengths[0]);
-    glCompileShader(vertex_shader);
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        GLint max_length = 0;
-        glGetShaderiv(vertex_shader, GL_INFO_LOG_LENGTH, &max_length);
-        char error_log[1024];
-        fprintf(stderr, "Vertex shader compilation failed\n");
-        glGetShaderInfoLog(vertex_shader, max_length, &max_length, &error_log[0]);
-        fprintf(stderr, "%s\n", &error_log[0]);
-        sys_fatal("vertex shader compilation failed (see terminal)");
-    }
-
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &sources[1], &lengths[1]);
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        GLint max_length = 0;
-        glGetShaderiv(fragment_shader, GL_INFO_LOG_LENGTH, &max_length);
-        char error_log[1024];
-        fprintf(stderr, "Fragment shader compilation failed\n");
-        glGetShaderInfoLog(fragment_shader, max_length, &max_length, &error_log[0]);
-        fprintf(stderr, "%s\n", &error_log[0]);
-        sys_fatal("fragment shader compilation failed (see terminal)");
-    }
-
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
+    GLuint shader_program = uber_prg ? uber_prg->opengl_program_id : gfx_opengl_shader_cache_load(shader_id);
+    bool from_cache = shader_program != 0;
+    if (!from_cache)
+        shader_program = gfx_opengl_compile_program(vs_buf, vs_len, fs_buf, fs_len);
 
     size_t cnt = 0;
 
-    struct ShaderProgram *prg = &shader_program_pool[shader_program_pool_size++];
+    struct ShaderProgram *prg = gfx_opengl_alloc_shader();
     prg->attrib_locations[cnt] = glGetAttribLocation(shader_program, "aVtxPos");
     prg->attrib_sizes[cnt] = 4;
     ++cnt;
@@ -471,6 +700,13 @@ static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shad
     prg->used_textures[1] = used_textures[1];
     prg->num_floats = num_floats;
     prg->num_attribs = cnt;
+    prg->uber = use_uber_shader;
+    prg->shared_program = uber_prg != NULL;
+    if (prg->uber) {
+        prg->uniform_locations[5] = glGetUniformLocation(shader_program, "uColorCombiner");
+        prg->uniform_locations[6] = glGetUniformLocation(shader_program, "uAlphaCombiner");
+        memcpy(prg->combiner, c, sizeof(prg->combiner));
+    }
 
     gfx_opengl_load_shader(prg);
 
@@ -494,13 +730,15 @@ static struct ShaderProgram *gfx_opengl_create_and_load_new_shader(uint32_t shad
         prg->used_noise = false;
     }
 
+    if (!from_cache) gfx_opengl_shader_cache_save(prg);
+
     return prg;
 }
 
 static struct ShaderProgram *gfx_opengl_lookup_shader(uint32_t shader_id) {
     for (size_t i = 0; i < shader_program_pool_size; i++) {
-        if (shader_program_pool[i].shader_id == shader_id) {
-            return &shader_program_pool[i];
+        if (shader_program_pool[i]->shader_id == shader_id) {
+            return shader_program_pool[i];
         }
     }
     return NULL;
@@ -601,6 +839,99 @@ static void gfx_opengl_set_use_alpha(bool use_alpha) {
 bool wireframeMode;
 bool enableWireframe;
 
+// Streaming vertex buffer
+// Batches are appended to one large ring instead of respecifying the buffer
+// on every draw. With buffer storage the ring stays mapped and each section
+// is fenced once it's filled, so it's only written again after the GPU is
+// done with it. Otherwise the ring is orphaned whenever it wraps and written
+// through unsynchronized mappings, or on old GL, respecified like before.
+
+// macOS stops at GL 4.1 without ARB_buffer_storage, and GLES 2 has neither it nor fences
+#if !defined(USE_GLES) && !defined(OSX_BUILD)
+# define VBO_RING_CAN_PERSIST 1
+#else
+# define VBO_RING_CAN_PERSIST 0
+#endif
+
+#define VBO_RING_SIZE (16 * 1024 * 1024)
+#define VBO_RING_SECTIONS 4
+#define VBO_RING_SECTION_SIZE (VBO_RING_SIZE / VBO_RING_SECTIONS)
+
+enum VboRingMode {
+    VBO_RING_NONE,
+    VBO_RING_ORPHAN,
+    VBO_RING_PERSISTENT,
+};
+
+static enum VboRingMode vbo_ring_mode;
+static uint8_t *vbo_ring_map;
+static size_t vbo_ring_offset;
+#if VBO_RING_CAN_PERSIST
+static int vbo_ring_section;
+static GLsync vbo_ring_fences[VBO_RING_SECTIONS];
+#endif
+
+static void gfx_opengl_init_vbo_ring(int vmajor, int vminor, bool is_es) {
+#if VBO_RING_CAN_PERSIST
+    bool has_buffer_storage = !is_es && ((vmajor == 4 && vminor >= 4) || vmajor > 4 || gl_has_extension("GL_ARB_buffer_storage"));
+# ifdef GLEW_STATIC
+    // the driver may still not hand out the entry points
+    has_buffer_storage = has_buffer_storage && glBufferStorage && glFenceSync && glClientWaitSync && glDeleteSync;
+# endif
+    if (has_buffer_storage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, VBO_RING_SIZE, NULL, flags);
+        vbo_ring_map = glMapBufferRange(GL_ARRAY_BUFFER, 0, VBO_RING_SIZE, flags);
+        if (vbo_ring_map) {
+            vbo_ring_mode = VBO_RING_PERSISTENT;
+            return;
+        }
+        // storage is immutable now, so the orphaning path below needs a fresh buffer
+        glDeleteBuffers(1, &opengl_vbo);
+        glGenBuffers(1, &opengl_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+    }
+#endif
+#ifndef USE_GLES
+    if (!is_es && (vmajor >= 3 || gl_has_extension("GL_ARB_map_buffer_range"))) {
+        glBufferData(GL_ARRAY_BUFFER, VBO_RING_SIZE, NULL, GL_STREAM_DRAW);
+        vbo_ring_mode = VBO_RING_ORPHAN;
+        return;
+    }
+#endif
+    vbo_ring_mode = VBO_RING_NONE;
+}
+
+// returns where in the ring size bytes can be written, aligned to a whole vertex
+static size_t gfx_opengl_vbo_ring_reserve(size_t size, size_t stride) {
+    size_t offset = (vbo_ring_offset + stride - 1) / stride * stride;
+    bool wrapped = offset + size > VBO_RING_SIZE;
+    if (wrapped) offset = 0;
+#if VBO_RING_CAN_PERSIST
+    if (vbo_ring_mode == VBO_RING_PERSISTENT) {
+        int last_section = (offset + size - 1) / VBO_RING_SECTION_SIZE;
+        while (vbo_ring_section != last_section || wrapped) {
+            vbo_ring_fences[vbo_ring_section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            vbo_ring_section = (vbo_ring_section + 1) % VBO_RING_SECTIONS;
+            GLsync fence = vbo_ring_fences[vbo_ring_section];
+            if (fence) {
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(fence);
+                vbo_ring_fences[vbo_ring_section] = NULL;
+            }
+            wrapped = false;
+        }
+    }
+#endif
+#ifndef USE_GLES
+    if (vbo_ring_mode == VBO_RING_ORPHAN && wrapped) {
+        glBufferData(GL_ARRAY_BUFFER, VBO_RING_SIZE, NULL, GL_STREAM_DRAW);
+    }
+#endif
+    vbo_ring_offset = offset + size;
+    return offset;
+}
+
 static void gfx_opengl_draw_triangles(float buf_vbo[], size_t buf_vbo_len, size_t buf_vbo_num_tris) {
     //printf("flushing %d tris\n", buf_vbo_num_tris);
     bool wireframe = wireframeMode || enableWireframe;
@@ -608,8 +939,35 @@ static void gfx_opengl_draw_triangles(float buf_vbo[], size_t buf_vbo_len, size_
         glPolygonMode(GL_FRONT, GL_LINE);
         glPolygonMode(GL_BACK, GL_LINE);
     }
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * buf_vbo_len, buf_vbo, GL_STREAM_DRAW);
-    glDrawArrays(GL_TRIANGLES, 0, 3 * buf_vbo_num_tris);
+    size_t size = sizeof(float) * buf_vbo_len;
+    size_t stride = size / (3 * buf_vbo_num_tris);
+    size_t offset = 0;
+    switch (vbo_ring_mode) {
+#if VBO_RING_CAN_PERSIST
+        case VBO_RING_PERSISTENT:
+            offset = gfx_opengl_vbo_ring_reserve(size, stride);
+            memcpy(vbo_ring_map + offset, buf_vbo, size);
+            break;
+#endif
+#ifndef USE_GLES
+        case VBO_RING_ORPHAN: {
+            offset = gfx_opengl_vbo_ring_reserve(size, stride);
+            void *map = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (map) {
+                memcpy(map, buf_vbo, size);
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            }
+            // the range was just reserved, so a plain upload lands in the same place
+            else glBufferSubData(GL_ARRAY_BUFFER, offset, size, buf_vbo);
+            break;
+        }
+#endif
+        default:
+            glBufferData(GL_ARRAY_BUFFER, size, buf_vbo, GL_STREAM_DRAW);
+            break;
+    }
+    // vertex attributes point at the start of the buffer, so skip ahead by whole vertices
+    glDrawArrays(GL_TRIANGLES, offset / stride, 3 * buf_vbo_num_tris);
     if(wireframe){
         glPolygonMode(GL_FRONT, GL_FILL);
         glPolygonMode(GL_BACK, GL_FILL);
@@ -631,6 +989,47 @@ static inline bool gl_get_version(int *major, int *minor, bool *is_es) {
     return (sscanf(vstr, "%d.%d", major, minor) == 2);
 }
 
+static void gfx_opengl_init_shader_cache(int vmajor, int vminor, bool is_es) {
+#ifndef USE_GLES
+    GLint num_formats = 0;
+    if (!is_es && ((vmajor == 4 && vminor >= 1) || vmajor > 4 || gl_has_extension("GL_ARB_get_program_binary")))
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    shader_cache_enabled = num_formats > 0;
+    if (!shader_cache_enabled) return;
+
+    char identity[1024];
+    gfx_opengl_shader_cache_identity(identity, sizeof(identity));
+    if (!gfx_opengl_shader_cache_read(identity))
+        shader_cache_stale = true;
+
+    // warm up every combiner seen before so none of them hitch mid-scene
+    for (size_t i = 0; i < shader_cache_count; i++) {
+        if (!gfx_opengl_lookup_shader(shader_cache[i].shader_id))
+            gfx_opengl_create_and_load_new_shader(shader_cache[i].shader_id);
+    }
+
+    if (shader_cache_stale) {
+        FILE *f = fopen(fs_get_write_path(SHADER_CACHE_FILE), "wb");
+        if (f) {
+            uint32_t len = strlen(identity);
+            fwrite(SHADER_CACHE_MAGIC, 8, 1, f);
+            fwrite(&len, sizeof(len), 1, f);
+            fwrite(identity, len, 1, f);
+            fclose(f);
+            for (size_t i = 0; i < shader_program_pool_size; i++)
+                gfx_opengl_shader_cache_save(shader_program_pool[i]);
+        }
+        shader_cache_stale = false;
+    }
+
+    for (size_t i = 0; i < shader_cache_count; i++)
+        free(shader_cache[i].binary);
+    free(shader_cache);
+    shader_cache = NULL;
+    shader_cache_count = 0;
+#endif
+}
+
 static void gfx_opengl_init(void) {
 #if FOR_WINDOWS || defined(OSX_BUILD)
     GLenum err;
@@ -652,21 +1051,115 @@ static void gfx_opengl_init(void) {
     glGenBuffers(1, &opengl_vbo);
     
     glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+    gfx_opengl_init_vbo_ring(vmajor, vminor, is_es);
+    use_uber_shader = configUberShader;
     
     glDepthFunc(GL_LEQUAL);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    gfx_opengl_init_shader_cache(vmajor, vminor, is_es);
 }
 
 static void gfx_opengl_on_resize(void) {
 }
 
 u8 frameBreak = 0;
-bool framebuffer_created = false;
-GLuint framebuffer_id;
-GLuint depthbuffer_id;
-GLuint rendertexture_id;
-GLuint drawbuffer_id;
-GLuint drawtexture_id;
+
+// Render targets
+// Framebuffers are kept between frames and only reallocated when their size,
+// sample count or format changes. Besides the game's own targets there's a
+// small pool of named ones for anything else that renders offscreen.
+
+struct GfxRenderTarget {
+    GLuint framebuffer, texture, depthbuffer;
+    uint32_t width, height;
+    int samples;
+    int flags;
+};
+
+#define RENDER_TARGET_POOL_SIZE 8
+
+static struct GfxRenderTarget game_target, draw_target;
+static struct {
+    char name[32];
+    struct GfxRenderTarget target;
+} render_target_pool[RENDER_TARGET_POOL_SIZE];
+
+static void gfx_opengl_free_render_target(struct GfxRenderTarget *target) {
+    if (target->framebuffer) glDeleteFramebuffers(1, &target->framebuffer);
+    if (target->texture) glDeleteTextures(1, &target->texture);
+    if (target->depthbuffer) glDeleteRenderbuffers(1, &target->depthbuffer);
+    memset(target, 0, sizeof(*target));
+}
+
+// binds the target, allocating it first if anything about it changed
+static void gfx_opengl_update_render_target(struct GfxRenderTarget *target, uint32_t width, uint32_t height, int samples, int flags) {
+    if (target->framebuffer && target->width == width && target->height == height && target->samples == samples && target->flags == flags) {
+        glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+        return;
+    }
+    gfx_opengl_free_render_target(target);
+    target->width = width;
+    target->height = height;
+    target->samples = samples;
+    target->flags = flags;
+
+    glGenFramebuffers(1, &target->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glGenTextures(1, &target->texture);
+    if (samples > 1) {
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target->texture);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_RGBA, width, height, GL_TRUE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, target->texture, 0);
+    }
+    else {
+        GLint filter = (flags & RENDER_TARGET_FLOAT) ? GL_NEAREST : GL_LINEAR;
+        glBindTexture(GL_TEXTURE_2D, target->texture);
+#ifdef USE_GLES
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+#else
+        if (flags & RENDER_TARGET_FLOAT) glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+        else glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+#endif
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+    }
+    if (flags & RENDER_TARGET_DEPTH) {
+        glGenRenderbuffers(1, &target->depthbuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, target->depthbuffer);
+        if (samples > 1) glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT, width, height);
+        else glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->depthbuffer);
+    }
+}
+
+unsigned int gfx_opengl_get_render_target(const char *name, uint32_t width, uint32_t height, int flags, unsigned int *texture) {
+    int slot = -1;
+    for (int i = 0; i < RENDER_TARGET_POOL_SIZE; i++) {
+        if (strcmp(render_target_pool[i].name, name) == 0) {
+            slot = i;
+            break;
+        }
+        if (slot == -1 && render_target_pool[i].name[0] == '\0') slot = i;
+    }
+    if (slot == -1) sys_fatal("out of render targets for %s", name);
+    if (render_target_pool[slot].name[0] == '\0') {
+        strncpy(render_target_pool[slot].name, name, sizeof(render_target_pool[slot].name) - 1);
+    }
+    struct GfxRenderTarget *target = &render_target_pool[slot].target;
+    gfx_opengl_update_render_target(target, width, height, 1, flags);
+    if (texture) *texture = target->texture;
+    return target->framebuffer;
+}
+
+void gfx_opengl_release_render_target(const char *name) {
+    for (int i = 0; i < RENDER_TARGET_POOL_SIZE; i++) {
+        if (strcmp(render_target_pool[i].name, name) != 0) continue;
+        gfx_opengl_free_render_target(&render_target_pool[i].target);
+        render_target_pool[i].name[0] = '\0';
+    }
+}
 
 static void gfx_opengl_start_frame(void) {
     if (frameBreak == 0) {
@@ -677,6 +1170,10 @@ static void gfx_opengl_start_frame(void) {
     }
     
     frame_count++;
+    last_shader_loads = shader_loads;
+    last_program_binds = program_binds;
+    shader_loads = 0;
+    program_binds = 0;
 
     if (configWindow.enable_antialias) {
         glEnable(GL_MULTISAMPLE);
@@ -686,37 +1183,8 @@ static void gfx_opengl_start_frame(void) {
         //glDisable(GL_DITHER);
     }
 
-    if (framebuffer_created) {
-        glDeleteFramebuffers(1, &framebuffer_id);
-        glDeleteRenderbuffers(1, &depthbuffer_id);
-        glDeleteTextures(1, &rendertexture_id);
-    }
-    framebuffer_created = true;
-
-    glGenFramebuffers(1, &framebuffer_id);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_id);
-    if (configWindow.enable_antialias) {
-        glGenTextures(1, &rendertexture_id);
-        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, rendertexture_id);
-        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 2, GL_RGBA, gfx_current_dimensions.width, gfx_current_dimensions.height, GL_TRUE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, rendertexture_id, 0);
-        glGenRenderbuffers(1, &depthbuffer_id);
-        glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer_id);
-        glRenderbufferStorageMultisample(GL_RENDERBUFFER, 2, GL_DEPTH_COMPONENT, gfx_current_dimensions.width, gfx_current_dimensions.height);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthbuffer_id);
-    }
-    else {
-        glGenTextures(1, &rendertexture_id);
-        glBindTexture(GL_TEXTURE_2D, rendertexture_id);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, gfx_current_dimensions.width, gfx_current_dimensions.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rendertexture_id, 0);
-        glGenRenderbuffers(1, &depthbuffer_id);
-        glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer_id);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, gfx_current_dimensions.width, gfx_current_dimensions.height);
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthbuffer_id);
-    }
+    gfx_opengl_update_render_target(&game_target, gfx_current_dimensions.width, gfx_current_dimensions.height,
+        configWindow.enable_antialias ? 2 : 1, RENDER_TARGET_DEPTH);
 
     glDisable(GL_SCISSOR_TEST);
     glDepthMask(GL_TRUE); // Must be set to clear Z-buffer
@@ -729,16 +1197,9 @@ static void gfx_opengl_start_frame(void) {
 }
 
 static void draw_to_draw_buffer() {
-    glGenFramebuffers(1, &drawbuffer_id);
-    glBindFramebuffer(GL_FRAMEBUFFER, drawbuffer_id);
-    glGenTextures(1, &drawtexture_id);
-    glBindTexture(GL_TEXTURE_2D, drawtexture_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, gfx_current_dimensions.width, gfx_current_dimensions.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, drawtexture_id, 0);
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_id);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawbuffer_id);
+    gfx_opengl_update_render_target(&draw_target, gfx_current_dimensions.width, gfx_current_dimensions.height, 1, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, game_target.framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_target.framebuffer);
     glBlitFramebuffer(
         0, 0, gfx_current_dimensions.width, gfx_current_dimensions.height,
         0, gfx_current_dimensions.height, gfx_current_dimensions.width, 0,
@@ -749,15 +1210,146 @@ static void draw_to_draw_buffer() {
 
 static void gfx_opengl_end_frame(void) {
     draw_to_draw_buffer();
-    saturn_imgui_set_frame_buffer((void*)(intptr_t)drawtexture_id, frameBreak == 1);
+    saturn_imgui_set_frame_buffer((void*)(intptr_t)draw_target.texture, frameBreak == 1);
     saturn_imgui_update();
-    glDeleteFramebuffers(1, &drawbuffer_id);
-    glDeleteTextures(1, &drawtexture_id);
 }
 
 static void gfx_opengl_finish_render(void) {
 }
 
+// Frame accumulation
+// Motion blur sums weighted sub-frames into a float target with additive
+// blending, the result is only resolved back to RGBA8 once per output frame
+
+static GLuint accum_program;
+static GLuint accum_vbo;
+static GLint accum_attrib_pos;
+static GLint accum_uniform_tex;
+static GLint accum_uniform_weight;
+static GLuint accum_framebuffer, accum_texture;
+static GLuint resolve_framebuffer, resolve_texture;
+static uint32_t accum_width, accum_height;
+
+static GLuint gfx_opengl_compile_accum_shader(GLenum type, const char *source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) sys_fatal("accumulation shader compilation failed");
+    return shader;
+}
+
+static void gfx_opengl_init_accum(void) {
+    static const char *vs =
+#ifdef USE_GLES
+        "#version 100\n"
+#else
+        "#version 120\n"
+#endif
+        "attribute vec2 aPos;\n"
+        "varying vec2 vUV;\n"
+        "void main() {\n"
+        "    vUV = aPos * 0.5 + 0.5;\n"
+        "    gl_Position = vec4(aPos, 0.0, 1.0);\n"
+        "}\n";
+    static const char *fs =
+#ifdef USE_GLES
+        "#version 100\n"
+        "precision mediump float;\n"
+#else
+        "#version 120\n"
+#endif
+        "uniform sampler2D uTex;\n"
+        "uniform float uWeight;\n"
+        "varying vec2 vUV;\n"
+        "void main() {\n"
+        "    gl_FragColor = texture2D(uTex, vUV) * uWeight;\n"
+        "}\n";
+    static const float quad[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+
+    accum_program = glCreateProgram();
+    glAttachShader(accum_program, gfx_opengl_compile_accum_shader(GL_VERTEX_SHADER, vs));
+    glAttachShader(accum_program, gfx_opengl_compile_accum_shader(GL_FRAGMENT_SHADER, fs));
+    glLinkProgram(accum_program);
+    accum_attrib_pos = glGetAttribLocation(accum_program, "aPos");
+    accum_uniform_tex = glGetUniformLocation(accum_program, "uTex");
+    accum_uniform_weight = glGetUniformLocation(accum_program, "uWeight");
+
+    glGenBuffers(1, &accum_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, accum_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+}
+
+// draws texture into framebuffer scaled by weight, leaving the game's GL state as it was
+static void gfx_opengl_accum_pass(GLuint framebuffer, GLuint texture, float weight, bool blend, bool clear) {
+    GLint viewport[4], scissor[4], texture_binding;
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetIntegerv(GL_SCISSOR_BOX, scissor);
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture_binding);
+    GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+    GLboolean blend_enabled = glIsEnabled(GL_BLEND);
+    struct ShaderProgram *prg = opengl_prg;
+    if (prg) gfx_opengl_unload_shader(prg);
+    gfx_opengl_release_program();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, accum_width, accum_height);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_SCISSOR_TEST);
+    if (clear) {
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    if (blend) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+    else glDisable(GL_BLEND);
+    glUseProgram(accum_program);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniform1i(accum_uniform_tex, 0);
+    glUniform1f(accum_uniform_weight, weight);
+    glBindBuffer(GL_ARRAY_BUFFER, accum_vbo);
+    glEnableVertexAttribArray(accum_attrib_pos);
+    glVertexAttribPointer(accum_attrib_pos, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisableVertexAttribArray(accum_attrib_pos);
+
+    glBindBuffer(GL_ARRAY_BUFFER, opengl_vbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, texture_binding);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glScissor(scissor[0], scissor[1], scissor[2], scissor[3]);
+    if (depth_test) glEnable(GL_DEPTH_TEST);
+    if (scissor_test) glEnable(GL_SCISSOR_TEST);
+    if (blend_enabled) glEnable(GL_BLEND);
+    else glDisable(GL_BLEND);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    if (prg) gfx_opengl_load_shader(prg);
+    else glUseProgram(0);
+}
+
+void gfx_opengl_accumulate(unsigned int texture, bool first, float weight) {
+    if (!accum_program) gfx_opengl_init_accum();
+    if (first) {
+        accum_width = gfx_current_dimensions.width;
+        accum_height = gfx_current_dimensions.height;
+        accum_framebuffer = gfx_opengl_get_render_target("accumulation", accum_width, accum_height, RENDER_TARGET_FLOAT, &accum_texture);
+        resolve_framebuffer = gfx_opengl_get_render_target("accumulation resolve", accum_width, accum_height, 0, &resolve_texture);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    gfx_opengl_accum_pass(accum_framebuffer, texture, weight, true, first);
+}
+
+unsigned int gfx_opengl_resolve_accumulation(void) {
+    gfx_opengl_accum_pass(resolve_framebuffer, accum_texture, 1.0f, false, false);
+    return resolve_texture;
+}
+
 static void gfx_opengl_shutdown(void) {
 }
 
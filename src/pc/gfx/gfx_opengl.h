@@ -6,4 +6,17 @@
 extern struct GfxRenderingAPI gfx_opengl_api;
 extern bool wireframeMode;
 
+#define RENDER_TARGET_DEPTH (1 << 0)
+#define RENDER_TARGET_FLOAT (1 << 1)
+
+// returns the framebuffer of a named offscreen target, bound, reallocating it if the size or flags changed
+unsigned int gfx_opengl_get_render_target(const char *name, uint32_t width, uint32_t height, int flags, unsigned int *texture);
+void gfx_opengl_release_render_target(const char *name);
+
+void gfx_opengl_accumulate(unsigned int texture, bool first, float weight);
+unsigned int gfx_opengl_resolve_accumulation(void);
+
+// shader loads and actual program binds during the last frame
+void gfx_opengl_get_shader_stats(int *loads, int *binds);
+
 #endif
@@ -6,6 +6,19 @@
 #include <stdbool.h>
 #include <assert.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define HAS_SSE2 1
+#define HAS_NEON 0
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HAS_SSE2 0
+#define HAS_NEON 1
+#else
+#define HAS_SSE2 0
+#define HAS_NEON 0
+#endif
+
 #ifndef _LANGUAGE_C
 #define _LANGUAGE_C
 #endif
@@ -18,6 +31,9 @@
 #include "gfx_window_manager_api.h"
 #include "gfx_rendering_api.h"
 #include "gfx_screen_config.h"
+#include "gfx_record.h"
+#include "gfx_texture_stream.h"
+#include "gfx_texture_pack_cache.h"
 
 #include "../platform.h"
 #include "../configfile.h"
@@ -33,6 +49,7 @@
 #include "src/engine/geo_layout.h"
 
 #include "game/object_list_processor.h"
+#include "game/area.h"
 #include "include/object_fields.h"
 
 #include "pc/pngutils.h"
@@ -55,7 +72,7 @@
 #define RATIO_X (gfx_current_dimensions.width / (2.0f * HALF_SCREEN_WIDTH))
 #define RATIO_Y (gfx_current_dimensions.height / (2.0f * HALF_SCREEN_HEIGHT))
 
-#define MAX_BUFFERED 256
+#define MAX_BUFFERED 4096
 #define MAX_LIGHTS 2
 #define MAX_VERTICES 64
 
@@ -95,11 +112,22 @@ struct TextureHashmapNode {
     uint32_t texture_id;
     uint8_t cms, cmt;
     bool linear_filter;
+
+    bool by_addr; // texture_addr is a key to compare by address, even with EXTERNAL_DATA
+    uint32_t hash;
+    uint32_t size_bytes;
+    uint32_t stream_serial; // nonzero while its pixels are being streamed in
+    struct TextureHashmapNode *lru_prev, *lru_next;
 };
 static struct {
     struct TextureHashmapNode *hashmap[HASHMAP_LEN];
     struct TextureHashmapNode pool[MAX_CACHED_TEXTURES];
-    uint32_t pool_pos;
+    uint32_t pool_pos; // nodes handed out so far, they come back through free_list
+    struct TextureHashmapNode *free_list;
+    struct TextureHashmapNode *lru_head, *lru_tail; // head is the most recently used
+    struct TextureHashmapNode *filling; // node the next upload belongs to
+    int filling_tile;
+    struct GfxTextureCacheStats stats;
 } gfx_texture_cache;
 
 struct ColorCombiner {
@@ -297,56 +325,325 @@ static struct ColorCombiner *gfx_lookup_or_create_color_combiner(uint32_t cc_id)
     return prev_combiner = comb;
 }
 
-static bool gfx_texture_cache_lookup(int tile, struct TextureHashmapNode **n, const uint8_t *orig_addr, uint32_t fmt, uint32_t siz) {
+// Deferred opaque batches
+// Each batch holds the triangles drawn with one shader, texture and sampler
+// setup. Batches are sorted by shader and texture when they're flushed.
+
+#define MAX_DEFERRED_BATCHES 256
+
+struct DeferredBatch {
+    struct ShaderProgram *prg;
+    struct TextureHashmapNode *textures[2];
+    bool linear_filter;
+    uint8_t cms, cmt;
+    struct XYWidthHeight viewport, scissor;
+    float *vbo;
+    size_t vbo_len, vbo_cap;
+    size_t num_tris;
+};
+
+static struct DeferredBatch deferred_batches[MAX_DEFERRED_BATCHES];
+static struct DeferredBatch *deferred_order[MAX_DEFERRED_BATCHES];
+static int num_deferred_batches;
+
+static int gfx_deferred_batch_compare(const void *a, const void *b) {
+    const struct DeferredBatch *x = *(const struct DeferredBatch **)a;
+    const struct DeferredBatch *y = *(const struct DeferredBatch **)b;
+    if (x->prg != y->prg) return (uintptr_t)x->prg < (uintptr_t)y->prg ? -1 : 1;
+    for (int i = 0; i < 2; i++) {
+        if (x->textures[i] != y->textures[i]) return (uintptr_t)x->textures[i] < (uintptr_t)y->textures[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+static void gfx_flush_deferred(void) {
+    if (num_deferred_batches == 0) return;
+    gfx_flush();
+    for (int i = 0; i < num_deferred_batches; i++) deferred_order[i] = &deferred_batches[i];
+    qsort(deferred_order, num_deferred_batches, sizeof(deferred_order[0]), gfx_deferred_batch_compare);
+
+    for (int b = 0; b < num_deferred_batches; b++) {
+        struct DeferredBatch *batch = deferred_order[b];
+        if (!rendering_state.depth_test) {
+            gfx_rapi->set_depth_test(true);
+            rendering_state.depth_test = true;
+        }
+        if (!rendering_state.depth_mask) {
+            gfx_rapi->set_depth_mask(true);
+            rendering_state.depth_mask = true;
+        }
+        if (rendering_state.decal_mode) {
+            gfx_rapi->set_zmode_decal(false);
+            rendering_state.decal_mode = false;
+        }
+        if (memcmp(&batch->viewport, &rendering_state.viewport, sizeof(batch->viewport)) != 0) {
+            gfx_rapi->set_viewport(batch->viewport.x, batch->viewport.y, batch->viewport.width, batch->viewport.height);
+            rendering_state.viewport = batch->viewport;
+        }
+        if (memcmp(&batch->scissor, &rendering_state.scissor, sizeof(batch->scissor)) != 0) {
+            gfx_rapi->set_scissor(batch->scissor.x, batch->scissor.y, batch->scissor.width, batch->scissor.height);
+            rendering_state.scissor = batch->scissor;
+        }
+        if (batch->prg != rendering_state.shader_program) {
+            gfx_rapi->unload_shader(rendering_state.shader_program);
+            gfx_rapi->load_shader(batch->prg);
+            rendering_state.shader_program = batch->prg;
+        }
+        if (rendering_state.alpha_blend) {
+            gfx_rapi->set_use_alpha(false);
+            rendering_state.alpha_blend = false;
+        }
+        for (int i = 0; i < 2; i++) {
+            struct TextureHashmapNode *tex = batch->textures[i];
+            if (!tex) continue;
+            if (tex != rendering_state.textures[i]) {
+                gfx_rapi->select_texture(i, tex->texture_id);
+                rendering_state.textures[i] = tex;
+            }
+            if (batch->linear_filter != tex->linear_filter || batch->cms != tex->cms || batch->cmt != tex->cmt) {
+                gfx_rapi->set_sampler_parameters(i, batch->linear_filter, batch->cms, batch->cmt);
+                tex->linear_filter = batch->linear_filter;
+                tex->cms = batch->cms;
+                tex->cmt = batch->cmt;
+            }
+        }
+        size_t tri_len = batch->vbo_len / batch->num_tris;
+        for (size_t tri = 0; tri < batch->num_tris; tri += MAX_BUFFERED) {
+            size_t num = batch->num_tris - tri < MAX_BUFFERED ? batch->num_tris - tri : MAX_BUFFERED;
+            gfx_rapi->draw_triangles(batch->vbo + tri * tri_len, num * tri_len, num);
+        }
+        batch->vbo_len = 0;
+        batch->num_tris = 0;
+    }
+    num_deferred_batches = 0;
+
+    // the textures and viewport bound now are whatever the last batch used
+    rdp.textures_changed[0] = true;
+    rdp.textures_changed[1] = true;
+    rdp.viewport_or_scissor_changed = true;
+}
+
+static void gfx_defer_triangle(struct ShaderProgram *prg, bool used_textures[2], bool linear_filter, const float *vbo, size_t len) {
+    static struct DeferredBatch *last_batch;
+    struct DeferredBatch key = {
+        .prg = prg,
+        .textures = {
+            used_textures[0] ? rendering_state.textures[0] : NULL,
+            used_textures[1] ? rendering_state.textures[1] : NULL,
+        },
+        .linear_filter = linear_filter,
+        .cms = rdp.texture_tile.cms,
+        .cmt = rdp.texture_tile.cmt,
+        .viewport = rdp.viewport,
+        .scissor = rdp.scissor,
+    };
+    #define BATCH_KEY_MATCHES(batch) ( \
+        (batch)->prg == key.prg && (batch)->textures[0] == key.textures[0] && (batch)->textures[1] == key.textures[1] && \
+        (batch)->linear_filter == key.linear_filter && (batch)->cms == key.cms && (batch)->cmt == key.cmt && \
+        !memcmp(&(batch)->viewport, &key.viewport, sizeof(key.viewport)) && !memcmp(&(batch)->scissor, &key.scissor, sizeof(key.scissor)))
+
+    struct DeferredBatch *batch = NULL;
+    if (last_batch && last_batch->num_tris > 0 && BATCH_KEY_MATCHES(last_batch)) batch = last_batch;
+    for (int i = 0; !batch && i < num_deferred_batches; i++) {
+        if (BATCH_KEY_MATCHES(&deferred_batches[i])) batch = &deferred_batches[i];
+    }
+    #undef BATCH_KEY_MATCHES
+    if (!batch) {
+        if (num_deferred_batches == MAX_DEFERRED_BATCHES) gfx_flush_deferred();
+        batch = &deferred_batches[num_deferred_batches++];
+        key.vbo = batch->vbo;
+        key.vbo_cap = batch->vbo_cap;
+        *batch = key;
+    }
+    if (batch->vbo_len + len > batch->vbo_cap) {
+        batch->vbo_cap = (batch->vbo_len + len) * 2;
+        batch->vbo = realloc(batch->vbo, batch->vbo_cap * sizeof(float));
+        if (!batch->vbo) sys_fatal("out of memory for deferred triangles");
+    }
+    memcpy(batch->vbo + batch->vbo_len, vbo, len * sizeof(float));
+    batch->vbo_len += len;
+    batch->num_tris++;
+    last_batch = batch;
+}
+
+static bool gfx_texture_cache_in_use(struct TextureHashmapNode *node) {
+    return node == rendering_state.textures[0] || node == rendering_state.textures[1] || node == gfx_texture_cache.filling;
+}
+
+static void gfx_texture_cache_lru_unlink(struct TextureHashmapNode *node) {
+    if (node->lru_prev) node->lru_prev->lru_next = node->lru_next;
+    else gfx_texture_cache.lru_head = node->lru_next;
+    if (node->lru_next) node->lru_next->lru_prev = node->lru_prev;
+    else gfx_texture_cache.lru_tail = node->lru_prev;
+    node->lru_prev = node->lru_next = NULL;
+}
+
+static void gfx_texture_cache_lru_push(struct TextureHashmapNode *node) {
+    node->lru_prev = NULL;
+    node->lru_next = gfx_texture_cache.lru_head;
+    if (gfx_texture_cache.lru_head) gfx_texture_cache.lru_head->lru_prev = node;
+    else gfx_texture_cache.lru_tail = node;
+    gfx_texture_cache.lru_head = node;
+}
+
+// Takes the least recently used texture out of the cache, skipping the ones
+// bound right now. Returns NULL if there's nothing left to evict.
+static struct TextureHashmapNode *gfx_texture_cache_evict(void) {
+    struct TextureHashmapNode *node = gfx_texture_cache.lru_tail;
+    while (node && gfx_texture_cache_in_use(node)) node = node->lru_prev;
+    if (!node) return NULL;
+
+    // deferred batches still draw with it, get them out before it's replaced,
+    // keeping the textures of the triangle being imported bound
+    for (int i = 0; i < num_deferred_batches; i++) {
+        if (deferred_batches[i].textures[0] == node || deferred_batches[i].textures[1] == node) {
+            struct TextureHashmapNode *bound[2] = { rendering_state.textures[0], rendering_state.textures[1] };
+            gfx_flush_deferred();
+            for (int tile = 0; tile < 2; tile++) {
+                if (bound[tile] && bound[tile] != rendering_state.textures[tile]) {
+                    gfx_rapi->select_texture(tile, bound[tile]->texture_id);
+                    rendering_state.textures[tile] = bound[tile];
+                }
+            }
+            break;
+        }
+    }
+
+    struct TextureHashmapNode **link = &gfx_texture_cache.hashmap[node->hash];
+    while (*link != node) link = &(*link)->next;
+    *link = node->next;
+    gfx_texture_cache_lru_unlink(node);
+
+    gfx_texture_cache.stats.bytes_used -= node->size_bytes;
+    gfx_texture_cache.stats.entries--;
+    gfx_texture_cache.stats.evictions++;
+    node->size_bytes = 0;
+    node->stream_serial = 0;
+    node->texture_addr = NULL;
+    node->next = NULL;
+    return node;
+}
+
+// Gives back the video memory of an evicted texture, keeping its id for reuse
+static void gfx_texture_cache_release(struct TextureHashmapNode *node, int tile) {
+    static const uint8_t empty[4];
+    gfx_rapi->select_texture(tile, node->texture_id);
+    gfx_rapi->upload_texture(empty, 1, 1);
+    node->next = gfx_texture_cache.free_list;
+    gfx_texture_cache.free_list = node;
+}
+
+static bool gfx_texture_cache_find(int tile, struct TextureHashmapNode **n, const uint8_t *orig_addr, uint32_t fmt, uint32_t siz, bool by_addr) {
     #ifdef EXTERNAL_DATA // hash and compare the data (i.e. the texture name) itself
-    size_t hash = string_hash(orig_addr);
-    #define CMPADDR(x, y) (x && !sys_strcasecmp((const char *)x, (const char *)y))
+    size_t hash = by_addr ? (uintptr_t)orig_addr : string_hash(orig_addr);
+    #define CMPADDR(node, y) ((node)->by_addr ? (node)->texture_addr == y : !sys_strcasecmp((const char *)(node)->texture_addr, (const char *)y))
     #else // hash and compare the address
     size_t hash = (uintptr_t)orig_addr;
-    #define CMPADDR(x, y) x == y
+    #define CMPADDR(node, y) (node)->texture_addr == y
     #endif
 
     hash = (hash >> HASH_SHIFT) & HASH_MASK;
 
-    struct TextureHashmapNode **node = &gfx_texture_cache.hashmap[hash];
-    while (*node != NULL && *node - gfx_texture_cache.pool < gfx_texture_cache.pool_pos) {
-        if (CMPADDR((*node)->texture_addr, orig_addr) && (*node)->fmt == fmt && (*node)->siz == siz) {
-            gfx_rapi->select_texture(tile, (*node)->texture_id);
-            *n = *node;
+    for (struct TextureHashmapNode *node = gfx_texture_cache.hashmap[hash]; node != NULL; node = node->next) {
+        if (node->by_addr == by_addr && CMPADDR(node, orig_addr) && node->fmt == fmt && node->siz == siz) {
+            gfx_rapi->select_texture(tile, node->texture_id);
+            if (node != gfx_texture_cache.lru_head) {
+                gfx_texture_cache_lru_unlink(node);
+                gfx_texture_cache_lru_push(node);
+            }
+            gfx_texture_cache.stats.hits++;
+            gfx_texture_cache.filling = NULL;
+            *n = node;
             return true;
         }
-        node = &(*node)->next;
     }
-    if (gfx_texture_cache.pool_pos == sizeof(gfx_texture_cache.pool) / sizeof(struct TextureHashmapNode)) {
-        // Pool is full. We just invalidate everything and start over.
-        gfx_texture_cache.pool_pos = 0;
-        node = &gfx_texture_cache.hashmap[hash];
-        // puts("Clearing texture cache");
-    }
-    *node = &gfx_texture_cache.pool[gfx_texture_cache.pool_pos++];
-    if ((*node)->texture_addr == NULL) {
-        (*node)->texture_id = gfx_rapi->new_texture();
+    gfx_texture_cache.stats.misses++;
+    gfx_texture_cache.filling = NULL;
+
+    struct TextureHashmapNode *node = gfx_texture_cache.free_list;
+    if (node) {
+        gfx_texture_cache.free_list = node->next;
+    } else if (gfx_texture_cache.pool_pos < MAX_CACHED_TEXTURES) {
+        node = &gfx_texture_cache.pool[gfx_texture_cache.pool_pos++];
+        node->texture_id = gfx_rapi->new_texture();
+    } else {
+        // every node holds a texture, replace the one that went unused the longest
+        node = gfx_texture_cache_evict();
+        if (!node) sys_fatal("texture cache has no texture left to evict");
     }
-    gfx_rapi->select_texture(tile, (*node)->texture_id);
+    gfx_rapi->select_texture(tile, node->texture_id);
     gfx_rapi->set_sampler_parameters(tile, false, 0, 0);
-    (*node)->cms = 0;
-    (*node)->cmt = 0;
-    (*node)->linear_filter = false;
-    (*node)->next = NULL;
-    (*node)->texture_addr = orig_addr;
-    (*node)->fmt = fmt;
-    (*node)->siz = siz;
-    *n = *node;
+    node->cms = 0;
+    node->cmt = 0;
+    node->linear_filter = false;
+    node->texture_addr = orig_addr;
+    node->fmt = fmt;
+    node->siz = siz;
+    node->by_addr = by_addr;
+    node->hash = hash;
+    node->size_bytes = 0;
+    node->next = gfx_texture_cache.hashmap[hash];
+    gfx_texture_cache.hashmap[hash] = node;
+    gfx_texture_cache_lru_push(node);
+    gfx_texture_cache.stats.entries++;
+    gfx_texture_cache.filling = node;
+    gfx_texture_cache.filling_tile = tile;
+    *n = node;
     return false;
     #undef CMPADDR
 }
 
+static bool gfx_texture_cache_lookup(int tile, struct TextureHashmapNode **n, const uint8_t *orig_addr, uint32_t fmt, uint32_t siz) {
+    return gfx_texture_cache_find(tile, n, orig_addr, fmt, siz, false);
+}
+
+// Uploads the texture that was just missed in the cache and accounts for it,
+// evicting least recently used ones until the cache fits in its budget again.
+static void gfx_upload_texture(const uint8_t *rgba32_buf, int width, int height) {
+    gfx_rapi->upload_texture(rgba32_buf, width, height);
+
+    struct TextureHashmapNode *node = gfx_texture_cache.filling;
+    if (!node) return;
+    gfx_texture_cache.stats.bytes_used -= node->size_bytes;
+    node->size_bytes = (uint32_t)width * height * 4;
+    gfx_texture_cache.stats.bytes_used += node->size_bytes;
+
+    gfx_texture_cache.stats.bytes_budget = (uint64_t)configTextureCacheBudget << 20;
+    if (gfx_texture_cache.stats.bytes_budget != 0 && gfx_texture_cache.stats.bytes_used > gfx_texture_cache.stats.bytes_budget) {
+        int tile = gfx_texture_cache.filling_tile;
+        struct TextureHashmapNode *victim;
+        while (gfx_texture_cache.stats.bytes_used > gfx_texture_cache.stats.bytes_budget && (victim = gfx_texture_cache_evict()) != NULL) {
+            gfx_texture_cache_release(victim, tile);
+        }
+        gfx_rapi->select_texture(tile, node->texture_id);
+    }
+    gfx_texture_cache.filling = NULL;
+}
+
+// Drops every cached texture, keeping the texture ids around for the next ones
+static void gfx_texture_cache_clear(void) {
+    gfx_flush_deferred();
+    gfx_texture_cache.filling = NULL;
+    rendering_state.textures[0] = NULL;
+    rendering_state.textures[1] = NULL;
+    rdp.textures_changed[0] = true;
+    rdp.textures_changed[1] = true;
+    struct TextureHashmapNode *victim;
+    while ((victim = gfx_texture_cache_evict()) != NULL) {
+        gfx_texture_cache_release(victim, 0);
+    }
+}
+
+void gfx_get_texture_cache_stats(struct GfxTextureCacheStats *stats) {
+    *stats = gfx_texture_cache.stats;
+}
+
 #ifndef EXTERNAL_DATA
 
 static void import_texture_rgba32(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes / 2;
     uint32_t height = (rdp.loaded_texture[tile].size_bytes / 2) / rdp.texture_tile.line_size_bytes;
-    gfx_rapi->upload_texture(rdp.loaded_texture[tile].addr, width, height);
+    gfx_upload_texture(rdp.loaded_texture[tile].addr, width, height);
 }
 
 static void import_texture_rgba16(int tile) {
@@ -367,7 +664,7 @@ static void import_texture_rgba16(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes / 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ia4(int tile) {
@@ -390,7 +687,7 @@ static void import_texture_ia4(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes * 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ia8(int tile) {
@@ -411,7 +708,7 @@ static void import_texture_ia8(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ia16(int tile) {
@@ -432,7 +729,7 @@ static void import_texture_ia16(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes / 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_i4(int tile) {
@@ -450,7 +747,7 @@ static void import_texture_i4(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes * 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_i8(int tile) {
@@ -467,7 +764,7 @@ static void import_texture_i8(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ci4(int tile) {
@@ -490,7 +787,7 @@ static void import_texture_ci4(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes * 2;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 static void import_texture_ci8(int tile) {
@@ -512,38 +809,94 @@ static void import_texture_ci8(int tile) {
     uint32_t width = rdp.texture_tile.line_size_bytes;
     uint32_t height = rdp.loaded_texture[tile].size_bytes / rdp.texture_tile.line_size_bytes;
     
-    gfx_rapi->upload_texture(rgba32_buf, width, height);
+    gfx_upload_texture(rgba32_buf, width, height);
 }
 
 #else // EXTERNAL_DATA
 
 void load_texture(const char *fullpath) {
     int w, h;
-    uint64_t imgsize = 0;
 
     char* model_data = saturn_actor_get_model_texture(fullpath, &w, &h);
     if (model_data) {
-        gfx_rapi->upload_texture(model_data, w, h);
+        gfx_upload_texture(model_data, w, h);
         return;
     }
 
-    u8 *imgdata = fs_load_file(fullpath, &imgsize);
-    if (imgdata) {
-        // TODO: implement stbi_callbacks or some shit instead of loading the whole texture
-        u8 *data = pngutils_read_png_from_memory(imgdata, imgsize, &w, &h, NULL, 4);
-        free(imgdata);
-        if (data) {
-            gfx_rapi->upload_texture(data, w, h);
-            pngutils_free(data); // don't need this anymore
-            return;
-        }
+    u8 *data = gfx_texture_pack_read(fullpath, &w, &h);
+    if (data) {
+        gfx_upload_texture(data, w, h);
+        pngutils_free(data); // don't need this anymore
+        return;
     }
 
     fprintf(stderr, "could not load texture: `%s`\n", fullpath);
     // replace with missing texture
-    gfx_rapi->upload_texture(missing_texture, MISSING_W, MISSING_H);
+    gfx_upload_texture(missing_texture, MISSING_W, MISSING_H);
+}
+
+static uint32_t texture_stream_serial;
+
+static bool gfx_texture_stream_blocking(void) {
+    return configTextureStreamBlockCapture && saturn_imgui_is_capturing_video();
+}
+
+// Hands a texture that just missed the cache to the streaming threads, with a placeholder uploaded until it's in
+static void gfx_request_texture(struct TextureHashmapNode *node, const char *fullpath, const char *name) {
+    static const uint8_t placeholder[4];
+    if (++texture_stream_serial == 0) texture_stream_serial++;
+    node->stream_serial = texture_stream_serial;
+    gfx_upload_texture(placeholder, 1, 1);
+    gfx_texture_stream_request(node, node->stream_serial, fullpath, name);
+}
+
+// Loads a texture on the streaming threads, with a placeholder bound until it's in
+static bool gfx_stream_texture(int tile, char *fullpath, const char *name) {
+    int w, h;
+    if (!configTextureStreaming || gfx_texture_stream_blocking()) return false;
+    if (saturn_actor_get_model_texture(fullpath, &w, &h)) return false; // already in memory
+
+    gfx_request_texture(rendering_state.textures[tile], fullpath, name);
+    return true;
 }
 
+// Uploads textures that are done decoding until the deadline (or all of them
+// if it's negative), returning how many were taken off the streaming threads
+static int gfx_upload_decoded_textures(double deadline) {
+    struct TextureHashmapNode *node;
+    uint32_t serial;
+    uint8_t *pixels;
+    int w, h;
+    int count = 0;
+    bool uploaded = false;
+    while ((deadline < 0 || gfx_wapi->get_time() < deadline) && gfx_texture_stream_poll((void **) &node, &serial, &pixels, &w, &h)) {
+        // skip textures that were evicted while they were decoding
+        if (node->stream_serial == serial) {
+            node->stream_serial = 0;
+            gfx_rapi->select_texture(0, node->texture_id);
+            gfx_texture_cache.filling = node;
+            gfx_texture_cache.filling_tile = 0;
+            if (pixels) gfx_upload_texture(pixels, w, h);
+            else gfx_upload_texture(missing_texture, MISSING_W, MISSING_H);
+            uploaded = true;
+        }
+        if (pixels) gfx_texture_stream_free(pixels);
+        count++;
+    }
+    if (uploaded && rendering_state.textures[0]) gfx_rapi->select_texture(0, rendering_state.textures[0]->texture_id);
+    return count;
+}
+
+// Uploads streamed textures that are done decoding for up to the frame's
+// upload budget, or every pending one while capturing so frames come out the same
+static void gfx_upload_streamed_textures(void) {
+    if (gfx_texture_stream_blocking()) {
+        gfx_texture_stream_wait();
+        gfx_upload_decoded_textures(-1);
+    } else {
+        gfx_upload_decoded_textures(gfx_wapi->get_time() + configTextureUploadBudget / 1000.0);
+    }
+}
 
 // this is taken straight from n64graphics
 static bool texname_to_texformat(const char *name, u8 *fmt, u8 *siz) {
@@ -581,44 +934,193 @@ static bool texname_to_texformat(const char *name, u8 *fmt, u8 *siz) {
 
 int preloaded_textures_count;
 
-// calls import_texture() on every texture in the res folder
-// we can get the format and size from the texture files
-// and then cache them using gfx_texture_cache_lookup
-bool preload_texture(void *user, const char *path) {
-    // strip off the extension
-    char texname[SYS_MAX_PATH];
-    strncpy(texname, path, sizeof(texname));
-    texname[sizeof(texname)-1] = 0;
-    char *dot = strrchr(texname, '.');
-    if (dot) *dot = 0;
-
-    // get the format and size from filename
-    u8 fmt, siz;
-    if (!texname_to_texformat(texname, &fmt, &siz)) {
-        fprintf(stderr, "unknown texture format: `%s`, skipping\n", texname);
-        return true; // just skip it, might be a stray skybox or something
-    }
-
-    char *actualname = texname;
-    // strip off the prefix // TODO: make a fs_ function for this shit
-    if (!strncmp(FS_TEXTUREDIR "/", actualname, 4)) actualname += 4;
-    // this will be stored in the hashtable, so make a copy
-    actualname = sys_strdup(actualname);
-    assert(actualname);
-
-    struct TextureHashmapNode *n;
-    if (!gfx_texture_cache_lookup(0, &n, actualname, fmt, siz)) {
-        load_texture(path); // new texture, load it
+#define PRECACHE_MAX_DEPTH 32
+#define PRECACHE_MAX_COMMANDS 65536
+#define PRECACHE_MODEL_COUNT 0x200 // size of gLoadedGraphNodes
+#define PRECACHE_AREA_COUNT 8
+
+struct PrecacheList {
+    char folder[SYS_MAX_PATH];
+    fs_pathlist_t paths;
+    bool enumerated;
+};
+
+// texture folders are only enumerated once, the pack's again when another pack is picked
+static struct PrecacheList precache_base, precache_pack;
+
+struct PrecacheNames {
+    const char **names;
+    int count, cap;
+};
+
+static void gfx_precache_add(struct PrecacheNames *list, const char *name) {
+    if (list->count == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 256;
+        list->names = realloc(list->names, list->cap * sizeof(const char *));
+        if (!list->names) sys_fatal("out of memory listing textures to precache");
+    }
+    list->names[list->count++] = name;
+}
+
+static void gfx_precache_enumerate(struct PrecacheList *list, const char *folder, struct PrecacheNames *names) {
+    if (!list->enumerated || strcmp(list->folder, folder)) {
+        // cached textures are keyed by the names in the old list
+        if (list->enumerated) {
+            gfx_texture_cache_clear();
+            fs_pathlist_free(&list->paths);
+        }
+        snprintf(list->folder, sizeof(list->folder), "%s", folder);
+        list->paths = fs_enumerate(folder, true);
+        list->enumerated = true;
+    }
+    size_t prefix = strlen(folder);
+    for (int i = 0; i < list->paths.numpaths; i++) {
+        const char *path = list->paths.paths[i];
+        if (strlen(path) <= prefix || sys_strcasecmp(sys_file_extension(path), "png")) continue;
+        path += prefix;
+        if (*path == '/') path++;
+        gfx_precache_add(names, path);
+    }
+}
+
+// Collects the texture names a display list sets, skipping DynOS textures
+static void gfx_precache_collect_dl(struct PrecacheNames *list, const Gfx *cmd, int depth, int *num_commands) {
+    extern bool dynos_gfx_is_texture(void *ptr);
+    if (!cmd || depth > PRECACHE_MAX_DEPTH) return;
+    for (; ++*num_commands < PRECACHE_MAX_COMMANDS; cmd++) {
+        switch ((uint8_t)(cmd->words.w0 >> 24)) {
+            case G_SETTIMG: {
+                void *name = (void *) cmd->words.w1;
+                // importing would mark a reloaded texture as uploaded before it's drawn
+                if (name && !dynos_gfx_is_texture(name)) gfx_precache_add(list, saturn_texture_forward(name));
+                break;
+            }
+            case G_DL:
+                if (((cmd->words.w0 >> 16) & 1) == G_DL_PUSH) {
+                    gfx_precache_collect_dl(list, (const Gfx *) cmd->words.w1, depth + 1, num_commands);
+                } else {
+                    cmd = (const Gfx *) cmd->words.w1 - 1;
+                }
+                break;
+            case (uint8_t)G_ENDDL:
+                return;
+        }
+    }
+}
+
+static void gfx_precache_collect_node(struct PrecacheNames *list, struct GraphNode *node, int depth) {
+    if (!node || depth > PRECACHE_MAX_DEPTH) return;
+    struct GraphNode *curr = node;
+    do {
+        switch (curr->type) {
+            case GRAPH_NODE_TYPE_TRANSLATION_ROTATION:
+            case GRAPH_NODE_TYPE_TRANSLATION:
+            case GRAPH_NODE_TYPE_ROTATION:
+            case GRAPH_NODE_TYPE_ANIMATED_PART:
+            case GRAPH_NODE_TYPE_BILLBOARD:
+            case GRAPH_NODE_TYPE_DISPLAY_LIST:
+            case GRAPH_NODE_TYPE_SCALE: {
+                // these all keep their display list right after the node
+                int num_commands = 0;
+                gfx_precache_collect_dl(list, ((struct GraphNodeDisplayList *) curr)->displayList, 0, &num_commands);
+                break;
+            }
+        }
+        gfx_precache_collect_node(list, curr->children, depth + 1);
+        curr = curr->next;
+    } while (curr && curr != node);
+}
+
+static void gfx_precache_dynos_texture(void *ptr, UNUSED void *user) {
+    extern s32 dynos_gfx_import_texture(void **key, void *ptr, const u8 **data, s32 *width, s32 *height);
+    struct TextureHashmapNode *node;
+    const u8 *data;
+    void *key;
+    s32 w, h;
+    s32 dynos_texture = dynos_gfx_import_texture(&key, ptr, &data, &w, &h);
+    if (!dynos_texture) return;
+    if (!gfx_texture_cache_find(0, &node, key, G_IM_FMT_RGBA, G_IM_SIZ_32b, true) || dynos_texture > 1) {
+        gfx_texture_cache.filling = node;
+        gfx_texture_cache.filling_tile = 0;
+        gfx_upload_texture(data, w, h);
         preloaded_textures_count++;
     }
-    return true;
+}
+
+// Loads textures ahead of time, decoding them on the streaming threads and
+// uploading them here as they come in. That's every texture of the base and
+// selected packs, or with level_only just the ones the current level's models
+// use. The textures of the loaded DynOS packs are always included.
+void gfx_precache_textures_with_progress(bool level_only, void (*progress)(int done, int total)) {
+    struct PrecacheNames names = { 0 };
+    char folder[SYS_MAX_PATH];
+    saturn_get_textures_folder(folder);
+    size_t folder_len = strlen(folder);
+    if (folder_len > 0 && folder[folder_len - 1] == '/') folder[folder_len - 1] = 0;
+
+    if (level_only) {
+        for (int i = 0; i < PRECACHE_AREA_COUNT; i++) {
+            if (gAreas && gAreas[i].unk04) gfx_precache_collect_node(&names, &gAreas[i].unk04->node, 0);
+        }
+        for (int i = 0; i < PRECACHE_MODEL_COUNT; i++) {
+            if (gLoadedGraphNodes[i]) gfx_precache_collect_node(&names, gLoadedGraphNodes[i], 0);
+        }
+    } else {
+        if (strcmp(folder, FS_TEXTUREDIR)) gfx_precache_enumerate(&precache_pack, folder, &names);
+        gfx_precache_enumerate(&precache_base, FS_TEXTUREDIR, &names);
+    }
+
+    gfx_flush_deferred();
+    dynos_gfx_for_each_texture(gfx_precache_dynos_texture, NULL);
+
+    int total = 0;
+    for (int i = 0; i < names.count; i++) {
+        // stop before textures being precached would evict each other
+        if (gfx_texture_cache.stats.entries >= MAX_CACHED_TEXTURES) break;
+
+        char texname[SYS_MAX_PATH];
+        u8 fmt, siz;
+        snprintf(texname, sizeof(texname), "%s", names.names[i]);
+        char *dot = strrchr(texname, '.');
+        if (dot && !sys_strcasecmp(dot, ".png")) *dot = 0;
+        if (!texname_to_texformat(texname, &fmt, &siz)) continue; // might be a stray skybox or something
+
+        struct TextureHashmapNode *node;
+        if (gfx_texture_cache_lookup(0, &node, (const uint8_t *) names.names[i], fmt, siz)) continue;
+        snprintf(texname, sizeof(texname), "%s/%s", folder, names.names[i]);
+        gfx_request_texture(node, texname, names.names[i]);
+        total++;
+    }
+    free(names.names);
+
+    int done = 0;
+    if (progress) progress(done, total);
+    while (gfx_texture_stream_wait_any()) {
+        done += gfx_upload_decoded_textures(-1);
+        if (progress) progress(done < total ? done : total, total);
+    }
+    preloaded_textures_count += total;
+    gfx_texture_pack_cache_flush();
+    if (rendering_state.textures[0]) gfx_rapi->select_texture(0, rendering_state.textures[0]->texture_id);
 }
 
 #endif // EXTERNAL_DATA
 
 static void import_texture(int tile) {
-    extern s32 dynos_gfx_import_texture(void **output, void *ptr, s32 tile, void *grapi, void **hashmap, void *pool, s32 *poolpos, s32 poolsize);
-    if (dynos_gfx_import_texture((void **) &rendering_state.textures[tile], (void *) rdp.loaded_texture[tile].addr, tile, gfx_rapi, (void **) gfx_texture_cache.hashmap, (void *) gfx_texture_cache.pool, (int *) &gfx_texture_cache.pool_pos, MAX_CACHED_TEXTURES)) { return; }
+    extern s32 dynos_gfx_import_texture(void **key, void *ptr, const u8 **data, s32 *width, s32 *height);
+    const u8 *dynos_data;
+    void *dynos_key;
+    s32 dynos_width, dynos_height;
+    s32 dynos_texture = dynos_gfx_import_texture(&dynos_key, (void *) rdp.loaded_texture[tile].addr, &dynos_data, &dynos_width, &dynos_height);
+    if (dynos_texture) {
+        // DynOS textures are keyed by their data node, and uploaded again when the node is reloaded
+        if (!gfx_texture_cache_find(tile, &rendering_state.textures[tile], dynos_key, G_IM_FMT_RGBA, G_IM_SIZ_32b, true) || dynos_texture > 1) {
+            gfx_texture_cache.filling = rendering_state.textures[tile];
+            gfx_texture_cache.filling_tile = tile;
+            gfx_upload_texture(dynos_data, dynos_width, dynos_height);
+        }
+        return;
+    }
     uint8_t fmt = rdp.texture_tile.fmt;
     uint8_t siz = rdp.texture_tile.siz;
 
@@ -639,6 +1141,7 @@ static void import_texture(int tile) {
     char texpath[SYS_MAX_PATH];
     saturn_get_textures_folder(texpath);
     snprintf(texname, sizeof(texname), "%s" "%s", texpath, (const char*)rdp.loaded_texture[tile].addr);
+    if (gfx_stream_texture(tile, texname, (const char*)rdp.loaded_texture[tile].addr)) return;
     saturn_fallback_texture(texname, (const char*)rdp.loaded_texture[tile].addr);
     load_texture(texname);
 #else
@@ -776,6 +1279,18 @@ static void gfx_sp_pop_matrix(uint32_t count) {
     }
 }
 
+// Maps a sub-rectangle of clip space onto the whole viewport, for tiled renders
+static bool projection_tiled = false;
+static float projection_tile[4];
+
+void gfx_set_projection_tile(float scale_x, float scale_y, float offset_x, float offset_y) {
+    projection_tiled = scale_x != 1 || scale_y != 1 || offset_x != 0 || offset_y != 0;
+    projection_tile[0] = scale_x;
+    projection_tile[1] = scale_y;
+    projection_tile[2] = offset_x;
+    projection_tile[3] = offset_y;
+}
+
 static float gfx_adjust_x_for_aspect_ratio(float x) {
     if (configWindow.jabo_mode) {
         // 4:3
@@ -787,8 +1302,6 @@ static float gfx_adjust_x_for_aspect_ratio(float x) {
 #define CC_SUPPORT    (1 << 0)
 #define SPARK_SUPPORT (1 << 1)
 
-#define SPARK && (support_flags & SPARK_SUPPORT)
-#define OVERRIDE cc_overrides[override_index++]
 #define COLOR_CLOSE_TO(R, G, B) \
 (                                \
     fabsf((R) - (r)) <= 1 &&      \
@@ -796,92 +1309,484 @@ static float gfx_adjust_x_for_aspect_ratio(float x) {
     fabsf((B) - (b)) <= 1           \
 )
 
-#define COLOR_SHADE 1, 1,         false
-#define COLOR_MAIN  0, intensity, true
+// Color code overrides
+// The slot of the color code a part of Mario is drawn with is picked from the
+// color of its ambient light, and the color code from the current object.
+// Neither changes between vertices, so both are worked out again only when
+// lights are loaded or the object changes.
+
+static const struct {
+    uint8_t r, g, b;
+    bool spark;
+} cc_light_colors[12] = {
+    [CC_HAT]             = { 0x7F, 0x00, 0x00, false },
+    [CC_OVERALLS]        = { 0x00, 0x00, 0x7F, false },
+    [CC_GLOVES]          = { 0x00, 0x7F, 0x00, false },
+    [CC_SHOES]           = { 0x39, 0x0E, 0x07, false },
+    [CC_SKIN]            = { 0x7F, 0x60, 0x3C, false },
+    [CC_HAIR]            = { 0x39, 0x03, 0x00, false },
+    [CC_SHIRT]           = { 0x7F, 0x7F, 0x00, true  },
+    [CC_SHOULDERS]       = { 0x00, 0x7F, 0x7F, true  },
+    [CC_ARMS]            = { 0x00, 0x7F, 0x40, true  },
+    [CC_OVERALLS_BOTTOM] = { 0x7F, 0x00, 0x7f, true  },
+    [CC_LEG_TOP]         = { 0x7F, 0x00, 0x40, true  },
+    [CC_LEG_BOTTOM]      = { 0x40, 0x00, 0x7F, true  },
+};
+
+static struct {
+    bool dirty;
+    bool override_colors;
+    int slot; // -1 if the ambient light isn't one of Mario's parts
+    bool mario_sideburn;
+    bool chroma_floor;
+    struct ColorTemplate *colors; // null if the object has no color code
+} cc_lookup = { .dirty = true };
+
+static void gfx_update_cc_lookup(void) {
+    int r = rsp.current_lights[rsp.current_num_lights - 1].col[0];
+    int g = rsp.current_lights[rsp.current_num_lights - 1].col[1];
+    int b = rsp.current_lights[rsp.current_num_lights - 1].col[2];
+
+    int marioIndex = gCurrentObject->oMarioActorIndex;
+    int support_flags = saturn_actor_get_support_flags(marioIndex);
+
+    cc_lookup.override_colors = (support_flags & CC_SUPPORT) || use_color_background;
+    cc_lookup.colors = saturn_actor_get_colorcode(marioIndex);
+    cc_lookup.mario_sideburn = COLOR_CLOSE_TO(0x73, 0x06, 0x00); // creator mario sideburn
+    cc_lookup.chroma_floor   = COLOR_CLOSE_TO(0x3F, 0x32, 0x19); // chroma floor
+    cc_lookup.slot = -1;
+    for (int i = 0; i < 12; i++) {
+        bool match = COLOR_CLOSE_TO(cc_light_colors[i].r, cc_light_colors[i].g, cc_light_colors[i].b);
+        if (cc_light_colors[i].spark && !(support_flags & SPARK_SUPPORT)) match = false;
+        if (i == CC_HAIR) match |= cc_lookup.mario_sideburn;
+        if (match) {
+            cc_lookup.slot = i;
+            break;
+        }
+    }
+    cc_lookup.dirty = false;
+}
+
+// Vertex transform
+// Positions, clip codes and fog factors are computed four vertices at a time
+// with SSE2 or NEON. The vector math runs in the same order as the scalar
+// version, and this file is built with -ffp-contract=off so the compiler
+// doesn't fuse either one into FMAs, so both give the same bits. gfx_init
+// checks that on a set of random vertices and falls back to the scalar path
+// if they differ; building with GFX_VERIFY_VERTEX_SIMD checks every vector
+// result against the scalar path.
+
+static void gfx_transform_vertex(const Vtx_t *v, struct LoadedVertex *d, float aspect, bool fog) {
+    float x = v->ob[0] * rsp.MP_matrix[0][0] + v->ob[1] * rsp.MP_matrix[1][0] + v->ob[2] * rsp.MP_matrix[2][0] + rsp.MP_matrix[3][0];
+    float y = v->ob[0] * rsp.MP_matrix[0][1] + v->ob[1] * rsp.MP_matrix[1][1] + v->ob[2] * rsp.MP_matrix[2][1] + rsp.MP_matrix[3][1];
+    float z = v->ob[0] * rsp.MP_matrix[0][2] + v->ob[1] * rsp.MP_matrix[1][2] + v->ob[2] * rsp.MP_matrix[2][2] + rsp.MP_matrix[3][2];
+    float w = v->ob[0] * rsp.MP_matrix[0][3] + v->ob[1] * rsp.MP_matrix[1][3] + v->ob[2] * rsp.MP_matrix[2][3] + rsp.MP_matrix[3][3];
+    
+    x = x * (4.0f / 3.0f) / aspect;
+    if (projection_tiled) {
+        x = x * projection_tile[0] + w * projection_tile[2];
+        y = y * projection_tile[1] + w * projection_tile[3];
+    }
+    
+    // trivial clip rejection
+    d->clip_rej = 0;
+    if (x < -w) d->clip_rej |= 1;
+    if (x > w) d->clip_rej |= 2;
+    if (y < -w) d->clip_rej |= 4;
+    if (y > w) d->clip_rej |= 8;
+    if (z < -w) d->clip_rej |= 16;
+    if (z > w) d->clip_rej |= 32;
+    
+    d->x = x;
+    d->y = y;
+    d->z = z;
+    d->w = w;
+    
+    if (fog) {
+        if (fabsf(w) < 0.001f) {
+            // To avoid division by zero
+            w = 0.001f;
+        }
+        
+        float winv = 1.0f / w;
+        if (winv < 0.0f) {
+            winv = 32767.0f;
+        }
+        
+        float fog_z = z * winv * rsp.fog_mul + rsp.fog_offset;
+        if (fog_z < 0) fog_z = 0;
+        if (fog_z > 255) fog_z = 255;
+        d->color.a = fog_z; // Use alpha variable to store fog factor
+    }
+}
 
-#define OVERRIDE_COLOR(cc_index, mode) else if (OVERRIDE) override_cc_color(&r, &g, &b, cc_index, marioIndex, mode)
+#if HAS_SSE2 || HAS_NEON
+// stores the four lanes of one vector step, clip holds the six comparison masks in order
+static void gfx_store_transformed_vertices(struct LoadedVertex *d, const float x[4], const float y[4], const float z[4], const float w[4], const uint32_t clip[6][4], const float fog_z[4], bool fog) {
+    for (int i = 0; i < 4; i++) {
+        d[i].clip_rej = 0;
+        for (int k = 0; k < 6; k++) {
+            if (clip[k][i]) d[i].clip_rej |= 1 << k;
+        }
+        d[i].x = x[i];
+        d[i].y = y[i];
+        d[i].z = z[i];
+        d[i].w = w[i];
+        if (fog) d[i].color.a = fog_z[i];
+    }
+}
+#endif
+
+#if HAS_SSE2
+static void gfx_transform_vertices_simd(const Vtx *vertices, struct LoadedVertex *d, float aspect, bool fog) {
+    __m128 ox = _mm_loadu_ps(vertices[0].v.ob);
+    __m128 oy = _mm_loadu_ps(vertices[1].v.ob);
+    __m128 oz = _mm_loadu_ps(vertices[2].v.ob);
+    __m128 unused = _mm_loadu_ps(vertices[3].v.ob);
+    _MM_TRANSPOSE4_PS(ox, oy, oz, unused);
+    
+    #define TRANSFORM_ROW(c) _mm_add_ps(_mm_add_ps(_mm_add_ps( \
+        _mm_mul_ps(ox, _mm_set1_ps(rsp.MP_matrix[0][c])), \
+        _mm_mul_ps(oy, _mm_set1_ps(rsp.MP_matrix[1][c]))), \
+        _mm_mul_ps(oz, _mm_set1_ps(rsp.MP_matrix[2][c]))), \
+        _mm_set1_ps(rsp.MP_matrix[3][c]))
+    __m128 x = TRANSFORM_ROW(0);
+    __m128 y = TRANSFORM_ROW(1);
+    __m128 z = TRANSFORM_ROW(2);
+    __m128 w = TRANSFORM_ROW(3);
+    #undef TRANSFORM_ROW
+    
+    x = _mm_div_ps(_mm_mul_ps(x, _mm_set1_ps(4.0f / 3.0f)), _mm_set1_ps(aspect));
+    if (projection_tiled) {
+        x = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(projection_tile[0])), _mm_mul_ps(w, _mm_set1_ps(projection_tile[2])));
+        y = _mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(projection_tile[1])), _mm_mul_ps(w, _mm_set1_ps(projection_tile[3])));
+    }
+    
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 neg_w = _mm_xor_ps(w, sign);
+    uint32_t clip[6][4];
+    _mm_storeu_si128((__m128i *)clip[0], _mm_castps_si128(_mm_cmplt_ps(x, neg_w)));
+    _mm_storeu_si128((__m128i *)clip[1], _mm_castps_si128(_mm_cmpgt_ps(x, w)));
+    _mm_storeu_si128((__m128i *)clip[2], _mm_castps_si128(_mm_cmplt_ps(y, neg_w)));
+    _mm_storeu_si128((__m128i *)clip[3], _mm_castps_si128(_mm_cmpgt_ps(y, w)));
+    _mm_storeu_si128((__m128i *)clip[4], _mm_castps_si128(_mm_cmplt_ps(z, neg_w)));
+    _mm_storeu_si128((__m128i *)clip[5], _mm_castps_si128(_mm_cmpgt_ps(z, w)));
+    
+    float fog_z[4];
+    if (fog) {
+        __m128 tiny = _mm_cmplt_ps(_mm_andnot_ps(sign, w), _mm_set1_ps(0.001f));
+        __m128 safe_w = _mm_or_ps(_mm_and_ps(tiny, _mm_set1_ps(0.001f)), _mm_andnot_ps(tiny, w));
+        __m128 winv = _mm_div_ps(_mm_set1_ps(1.0f), safe_w);
+        __m128 behind = _mm_cmplt_ps(winv, _mm_setzero_ps());
+        winv = _mm_or_ps(_mm_and_ps(behind, _mm_set1_ps(32767.0f)), _mm_andnot_ps(behind, winv));
+        __m128 f = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(z, winv), _mm_set1_ps(rsp.fog_mul)), _mm_set1_ps(rsp.fog_offset));
+        f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+        _mm_storeu_ps(fog_z, f);
+    }
+    
+    float xs[4], ys[4], zs[4], ws[4];
+    _mm_storeu_ps(xs, x);
+    _mm_storeu_ps(ys, y);
+    _mm_storeu_ps(zs, z);
+    _mm_storeu_ps(ws, w);
+    gfx_store_transformed_vertices(d, xs, ys, zs, ws, (const uint32_t (*)[4])clip, fog_z, fog);
+}
+#elif HAS_NEON
+static void gfx_transform_vertices_simd(const Vtx *vertices, struct LoadedVertex *d, float aspect, bool fog) {
+    float32x4x2_t t01 = vtrnq_f32(vld1q_f32(vertices[0].v.ob), vld1q_f32(vertices[1].v.ob));
+    float32x4x2_t t23 = vtrnq_f32(vld1q_f32(vertices[2].v.ob), vld1q_f32(vertices[3].v.ob));
+    float32x4_t ox = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    float32x4_t oy = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    float32x4_t oz = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    
+    // separate multiplies and adds like the scalar path, fused ones would round differently
+    #define TRANSFORM_ROW(c) vaddq_f32(vaddq_f32(vaddq_f32( \
+        vmulq_n_f32(ox, rsp.MP_matrix[0][c]), \
+        vmulq_n_f32(oy, rsp.MP_matrix[1][c])), \
+        vmulq_n_f32(oz, rsp.MP_matrix[2][c])), \
+        vdupq_n_f32(rsp.MP_matrix[3][c]))
+    float32x4_t x = TRANSFORM_ROW(0);
+    float32x4_t y = TRANSFORM_ROW(1);
+    float32x4_t z = TRANSFORM_ROW(2);
+    float32x4_t w = TRANSFORM_ROW(3);
+    #undef TRANSFORM_ROW
+    
+    x = vdivq_f32(vmulq_n_f32(x, 4.0f / 3.0f), vdupq_n_f32(aspect));
+    if (projection_tiled) {
+        x = vaddq_f32(vmulq_n_f32(x, projection_tile[0]), vmulq_n_f32(w, projection_tile[2]));
+        y = vaddq_f32(vmulq_n_f32(y, projection_tile[1]), vmulq_n_f32(w, projection_tile[3]));
+    }
+    
+    float32x4_t neg_w = vnegq_f32(w);
+    uint32_t clip[6][4];
+    vst1q_u32(clip[0], vcltq_f32(x, neg_w));
+    vst1q_u32(clip[1], vcgtq_f32(x, w));
+    vst1q_u32(clip[2], vcltq_f32(y, neg_w));
+    vst1q_u32(clip[3], vcgtq_f32(y, w));
+    vst1q_u32(clip[4], vcltq_f32(z, neg_w));
+    vst1q_u32(clip[5], vcgtq_f32(z, w));
+    
+    float fog_z[4];
+    if (fog) {
+        float32x4_t safe_w = vbslq_f32(vcltq_f32(vabsq_f32(w), vdupq_n_f32(0.001f)), vdupq_n_f32(0.001f), w);
+        float32x4_t winv = vdivq_f32(vdupq_n_f32(1.0f), safe_w);
+        winv = vbslq_f32(vcltq_f32(winv, vdupq_n_f32(0.0f)), vdupq_n_f32(32767.0f), winv);
+        float32x4_t f = vaddq_f32(vmulq_n_f32(vmulq_f32(z, winv), rsp.fog_mul), vdupq_n_f32(rsp.fog_offset));
+        f = vminq_f32(vmaxq_f32(f, vdupq_n_f32(0.0f)), vdupq_n_f32(255.0f));
+        vst1q_f32(fog_z, f);
+    }
+    
+    float xs[4], ys[4], zs[4], ws[4];
+    vst1q_f32(xs, x);
+    vst1q_f32(ys, y);
+    vst1q_f32(zs, z);
+    vst1q_f32(ws, w);
+    gfx_store_transformed_vertices(d, xs, ys, zs, ws, (const uint32_t (*)[4])clip, fog_z, fog);
+}
+#endif
+
+#if HAS_SSE2 || HAS_NEON
+static bool vertex_simd_enabled = true;
+
+static bool gfx_transform_vertices_equal(const struct LoadedVertex *a, const struct LoadedVertex *b, bool fog) {
+    return !memcmp(&a->x, &b->x, sizeof(float) * 4) && a->clip_rej == b->clip_rej && (!fog || a->color.a == b->color.a);
+}
+
+// Runs both transform paths over random vertices and matrices, with and
+// without fog and tiled projections, returning false if any result differs
+static bool gfx_transform_vertices_self_test(void) {
+    float saved_matrix[4][4];
+    memcpy(saved_matrix, rsp.MP_matrix, sizeof(saved_matrix));
+    int16_t saved_fog_mul = rsp.fog_mul, saved_fog_offset = rsp.fog_offset;
+    bool saved_tiled = projection_tiled;
+    float saved_tile[4];
+    memcpy(saved_tile, projection_tile, sizeof(saved_tile));
+
+    uint32_t seed = 0x5a7u;
+    #define SELF_TEST_RANDOM(range) ((seed = seed * 1664525u + 1013904223u), ((float)(seed >> 8) / (float)(1 << 24) * 2.0f - 1.0f) * (range))
+    bool equal = true;
+    for (int round = 0; round < 64 && equal; round++) {
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) rsp.MP_matrix[r][c] = SELF_TEST_RANDOM(r == 3 ? 2000.0f : 2.0f);
+        }
+        rsp.fog_mul = (int16_t)SELF_TEST_RANDOM(32000.0f);
+        rsp.fog_offset = (int16_t)SELF_TEST_RANDOM(32000.0f);
+        projection_tiled = round & 1;
+        for (int k = 0; k < 4; k++) projection_tile[k] = SELF_TEST_RANDOM(4.0f);
+        float aspect = 1.0f + (SELF_TEST_RANDOM(1.0f) + 1.0f);
+
+        Vtx vertices[4];
+        memset(vertices, 0, sizeof(vertices));
+        for (int i = 0; i < 4; i++) {
+            for (int k = 0; k < 3; k++) vertices[i].v.ob[k] = SELF_TEST_RANDOM(8000.0f);
+        }
+        // near-zero w hits the division guard
+        if (round % 8 == 0) vertices[0].v.ob[0] = vertices[0].v.ob[1] = vertices[0].v.ob[2] = 0.0f;
+        for (int fog = 0; fog < 2 && equal; fog++) {
+            struct LoadedVertex simd[4], scalar[4];
+            memset(simd, 0, sizeof(simd));
+            memset(scalar, 0, sizeof(scalar));
+            gfx_transform_vertices_simd(vertices, simd, aspect, fog);
+            for (int i = 0; i < 4; i++) {
+                gfx_transform_vertex(&vertices[i].v, &scalar[i], aspect, fog);
+                equal = equal && gfx_transform_vertices_equal(&simd[i], &scalar[i], fog);
+            }
+        }
+    }
+    #undef SELF_TEST_RANDOM
+
+    memcpy(rsp.MP_matrix, saved_matrix, sizeof(saved_matrix));
+    rsp.fog_mul = saved_fog_mul;
+    rsp.fog_offset = saved_fog_offset;
+    projection_tiled = saved_tiled;
+    memcpy(projection_tile, saved_tile, sizeof(saved_tile));
+    return equal;
+}
+#endif
+
+static void gfx_transform_vertices(size_t n_vertices, struct LoadedVertex *d, const Vtx *vertices, bool fog) {
+    float aspect = configWindow.jabo_mode ? (float)4 / (float)3 : (float)gfx_current_dimensions.width / (float)gfx_current_dimensions.height;
+    size_t i = 0;
+#if HAS_SSE2 || HAS_NEON
+    for (; vertex_simd_enabled && i + 4 <= n_vertices; i += 4) {
+        gfx_transform_vertices_simd(&vertices[i], &d[i], aspect, fog);
+#ifdef GFX_VERIFY_VERTEX_SIMD
+        for (int j = 0; j < 4; j++) {
+            struct LoadedVertex ref = d[i + j];
+            gfx_transform_vertex(&vertices[i + j].v, &ref, aspect, fog);
+            if (!gfx_transform_vertices_equal(&ref, &d[i + j], fog)) {
+                sys_fatal("vector vertex transform differs from scalar at vertex %d", (int)(i + j));
+            }
+        }
+#endif
+    }
+#endif
+    for (; i < n_vertices; i++) {
+        gfx_transform_vertex(&vertices[i].v, &d[i], aspect, fog);
+    }
+}
+
+// Repeated vertex load lighting cache
+// The same vertices are often loaded again in a frame with only the position
+// changed, like copies of an object facing the same way. Lighting depends on
+// the lights as they were set and the orientation of the modelview matrix, not
+// its translation, so those loads reuse the colors and texture coordinates of
+// the last one and only transform the positions again. Actors sharing a model
+// and the colors of the part share entries too. Without directional
+// lights or texgen the orientation doesn't matter either. Vertex data can't
+// change while a frame is interpreted, so entries only live for one frame.
+
+#define INSTANCE_CACHE_SIZE 256
+
+// what the current model space light coefficients were computed from, they
+// aren't recomputed on every light or matrix change
+struct InstanceLightSource {
+    int8_t dirs[MAX_LIGHTS][3];
+    float world_dir[3];
+    float rotation[3][3];
+};
+
+static struct InstanceLightSource instance_light_source;
+
+struct InstanceLightKey {
+    const Vtx *vertices;
+    uint32_t n_vertices;
+    uint32_t texture_gen;
+    uint16_t scale_s, scale_t;
+    int num_lights;
+    uint8_t colors[MAX_LIGHTS + 1][3];
+    struct InstanceLightSource source;
+    int cc_slot;
+    unsigned int cc_colors[3][2]; // the slot's colors, so actors with the same colors share entries
+    bool has_cc, override_colors, mario_sideburn, chroma_floor, color_background;
+    uint8_t chroma[3];
+    float lighting_color[3];
+};
+
+struct InstanceLitVertex {
+    uint8_t r, g, b;
+    short u, v;
+};
+
+static struct InstanceCacheEntry {
+    uint32_t frame;
+    struct InstanceLightKey key;
+    struct InstanceLitVertex lit[MAX_VERTICES];
+} instance_cache[INSTANCE_CACHE_SIZE];
+static uint32_t instance_cache_frame;
+
+// everything the lit colors and texture coordinates of a vertex load depend on
+static void gfx_instance_light_key(struct InstanceLightKey *key, const Vtx *vertices, size_t n_vertices) {
+    // keys are compared with memcmp, so padding has to be cleared
+    memset(key, 0, sizeof(*key));
+    key->vertices = vertices;
+    key->n_vertices = n_vertices;
+    key->texture_gen = rsp.geometry_mode & G_TEXTURE_GEN;
+    key->scale_s = rsp.texture_scaling_factor.s;
+    key->scale_t = rsp.texture_scaling_factor.t;
+    key->num_lights = rsp.current_num_lights;
+    for (int i = 0; i < rsp.current_num_lights; i++) {
+        memcpy(key->colors[i], rsp.current_lights[i].col, 3);
+    }
+    if (rsp.current_num_lights > 1 || key->texture_gen) key->source = instance_light_source;
+    // only the colors of the part being lit matter, not which actor they belong to
+    key->cc_slot = cc_lookup.override_colors ? cc_lookup.slot : -1;
+    key->has_cc = key->cc_slot >= 0 && cc_lookup.colors;
+    if (key->has_cc) {
+        struct ColorTemplate *cc = &cc_lookup.colors[key->cc_slot];
+        memcpy(key->cc_colors[0], cc->red, sizeof(key->cc_colors[0]));
+        memcpy(key->cc_colors[1], cc->green, sizeof(key->cc_colors[1]));
+        memcpy(key->cc_colors[2], cc->blue, sizeof(key->cc_colors[2]));
+    }
+    key->override_colors = cc_lookup.override_colors;
+    key->mario_sideburn = cc_lookup.mario_sideburn;
+    key->chroma_floor = cc_lookup.chroma_floor;
+    key->color_background = use_color_background;
+    if (key->chroma_floor) {
+        key->chroma[0] = chromaColor.red[1];
+        key->chroma[1] = chromaColor.green[1];
+        key->chroma[2] = chromaColor.blue[1];
+    }
+    memcpy(key->lighting_color, gLightingColor, sizeof(key->lighting_color));
+}
 
 static void gfx_sp_vertex(size_t n_vertices, size_t dest_index, const Vtx *vertices) {
+    bool fog = (rsp.geometry_mode & G_FOG) && enable_fog;
+    gfx_transform_vertices(n_vertices, &rsp.loaded_vertices[dest_index], vertices, fog);
+
+    struct InstanceCacheEntry *cached = NULL;
+    bool cache_hit = false;
+    if (rsp.geometry_mode & G_LIGHTING) {
+        if (rsp.lights_changed) {
+            for (int i = 0; i < rsp.current_num_lights - 1; i++) {
+                calculate_normal_dir(&rsp.current_lights[i], rsp.current_lights_coeffs[i]);
+            }
+            static const Light_t lookat_x = {{0, 0, 0}, 0, {0, 0, 0}, 0, {127, 0, 0}, 0};
+            static const Light_t lookat_y = {{0, 0, 0}, 0, {0, 0, 0}, 0, {0, 127, 0}, 0};
+            calculate_normal_dir(&lookat_x, rsp.current_lookat_coeffs[0]);
+            calculate_normal_dir(&lookat_y, rsp.current_lookat_coeffs[1]);
+            rsp.lights_changed = false;
+
+            struct InstanceLightSource *source = &instance_light_source;
+            memset(source, 0, sizeof(*source));
+            for (int i = 0; i < rsp.current_num_lights - 1; i++) {
+                memcpy(source->dirs[i], rsp.current_lights[i].dir, 3);
+            }
+            source->world_dir[0] = world_light_dir1;
+            source->world_dir[1] = world_light_dir2;
+            source->world_dir[2] = world_light_dir3;
+            for (int i = 0; i < 3; i++) {
+                memcpy(source->rotation[i], rsp.modelview_matrix_stack[rsp.modelview_matrix_stack_size - 1][i], sizeof(source->rotation[i]));
+            }
+        }
+        if (cc_lookup.dirty) gfx_update_cc_lookup();
+
+        if (n_vertices <= MAX_VERTICES) {
+            struct InstanceLightKey key;
+            gfx_instance_light_key(&key, vertices, n_vertices);
+            cached = &instance_cache[(((uintptr_t)vertices >> 4) ^ n_vertices) % INSTANCE_CACHE_SIZE];
+            cache_hit = cached->frame == instance_cache_frame && !memcmp(&cached->key, &key, sizeof(key));
+            if (!cache_hit) {
+                cached->frame = instance_cache_frame;
+                memcpy(&cached->key, &key, sizeof(key));
+            }
+        }
+    }
+    
     for (size_t i = 0; i < n_vertices; i++, dest_index++) {
         const Vtx_t *v = &vertices[i].v;
         const Vtx_tn *vn = &vertices[i].n;
         struct LoadedVertex *d = &rsp.loaded_vertices[dest_index];
         
-        float x = v->ob[0] * rsp.MP_matrix[0][0] + v->ob[1] * rsp.MP_matrix[1][0] + v->ob[2] * rsp.MP_matrix[2][0] + rsp.MP_matrix[3][0];
-        float y = v->ob[0] * rsp.MP_matrix[0][1] + v->ob[1] * rsp.MP_matrix[1][1] + v->ob[2] * rsp.MP_matrix[2][1] + rsp.MP_matrix[3][1];
-        float z = v->ob[0] * rsp.MP_matrix[0][2] + v->ob[1] * rsp.MP_matrix[1][2] + v->ob[2] * rsp.MP_matrix[2][2] + rsp.MP_matrix[3][2];
-        float w = v->ob[0] * rsp.MP_matrix[0][3] + v->ob[1] * rsp.MP_matrix[1][3] + v->ob[2] * rsp.MP_matrix[2][3] + rsp.MP_matrix[3][3];
-        
-        x = gfx_adjust_x_for_aspect_ratio(x);
-        
         short U = v->tc[0] * rsp.texture_scaling_factor.s >> 16;
         short V = v->tc[1] * rsp.texture_scaling_factor.t >> 16;
         
-        if (rsp.geometry_mode & G_LIGHTING) {
-            if (rsp.lights_changed) {
-                for (int i = 0; i < rsp.current_num_lights - 1; i++) {
-                    calculate_normal_dir(&rsp.current_lights[i], rsp.current_lights_coeffs[i]);
-                }
-                static const Light_t lookat_x = {{0, 0, 0}, 0, {0, 0, 0}, 0, {127, 0, 0}, 0};
-                static const Light_t lookat_y = {{0, 0, 0}, 0, {0, 0, 0}, 0, {0, 127, 0}, 0};
-                calculate_normal_dir(&lookat_x, rsp.current_lookat_coeffs[0]);
-                calculate_normal_dir(&lookat_y, rsp.current_lookat_coeffs[1]);
-                rsp.lights_changed = false;
-            }
-            
+        if ((rsp.geometry_mode & G_LIGHTING) && cache_hit) {
+            const struct InstanceLitVertex *lit = &cached->lit[i];
+            d->color.r = lit->r;
+            d->color.g = lit->g;
+            d->color.b = lit->b;
+            U = lit->u;
+            V = lit->v;
+        } else if (rsp.geometry_mode & G_LIGHTING) {
             int r = rsp.current_lights[rsp.current_num_lights - 1].col[0];
             int g = rsp.current_lights[rsp.current_num_lights - 1].col[1];
             int b = rsp.current_lights[rsp.current_num_lights - 1].col[2];
 
-            int marioIndex = gCurrentObject->oMarioActorIndex;
-            int support_flags = saturn_actor_get_support_flags(marioIndex);
-
-            bool override_colors = (support_flags & CC_SUPPORT) || use_color_background;
-
-            bool cc_overrides[12];
-            int override_index = 0;
-
-            OVERRIDE = COLOR_CLOSE_TO(0x7F, 0x00, 0x00)      ;      // hat
-            OVERRIDE = COLOR_CLOSE_TO(0x00, 0x00, 0x7F)      ;      // overalls
-            OVERRIDE = COLOR_CLOSE_TO(0x00, 0x7F, 0x00)      ;      // gloves
-            OVERRIDE = COLOR_CLOSE_TO(0x39, 0x0E, 0x07)      ;      // shoes
-            OVERRIDE = COLOR_CLOSE_TO(0x7F, 0x60, 0x3C)      ;      // skin
-            OVERRIDE = COLOR_CLOSE_TO(0x39, 0x03, 0x00)      ;      // hair
-            OVERRIDE = COLOR_CLOSE_TO(0x7F, 0x7F, 0x00) SPARK;      // shirt
-            OVERRIDE = COLOR_CLOSE_TO(0x00, 0x7F, 0x7F) SPARK;      // shoulders
-            OVERRIDE = COLOR_CLOSE_TO(0x00, 0x7F, 0x40) SPARK;      // arms
-            OVERRIDE = COLOR_CLOSE_TO(0x7F, 0x00, 0x7f) SPARK;      // overalls bottom
-            OVERRIDE = COLOR_CLOSE_TO(0x7F, 0x00, 0x40) SPARK;      // leg top
-            OVERRIDE = COLOR_CLOSE_TO(0x40, 0x00, 0x7F) SPARK;      // leg bottom
-            bool mario_sideburn = COLOR_CLOSE_TO(0x73, 0x06, 0x00); // creator mario sideburn
-            bool chroma_floor   = COLOR_CLOSE_TO(0x3F, 0x32, 0x19); // chroma floor
-            cc_overrides[CC_HAIR] |= mario_sideburn;
-
-            override_index = 0;
-
-            if (override_colors) {
-                if (false); // OVERRIDE_COLOR is an else-if tree
-                OVERRIDE_COLOR(CC_HAT,             COLOR_SHADE);
-                OVERRIDE_COLOR(CC_OVERALLS,        COLOR_SHADE);
-                OVERRIDE_COLOR(CC_GLOVES,          COLOR_SHADE);
-                OVERRIDE_COLOR(CC_SHOES,           COLOR_SHADE);
-                OVERRIDE_COLOR(CC_SKIN,            COLOR_SHADE);
-                OVERRIDE_COLOR(CC_HAIR,            COLOR_SHADE);
-                OVERRIDE_COLOR(CC_SHIRT,           COLOR_SHADE);
-                OVERRIDE_COLOR(CC_SHOULDERS,       COLOR_SHADE);
-                OVERRIDE_COLOR(CC_ARMS,            COLOR_SHADE);
-                OVERRIDE_COLOR(CC_OVERALLS_BOTTOM, COLOR_SHADE);
-                OVERRIDE_COLOR(CC_LEG_TOP,         COLOR_SHADE);
-                OVERRIDE_COLOR(CC_LEG_BOTTOM,      COLOR_SHADE);
+            int cc_slot = cc_lookup.override_colors ? cc_lookup.slot : -1;
+            struct ColorTemplate *cc = cc_lookup.colors;
+
+            if (cc_slot >= 0 && cc) {
+                r = cc[cc_slot].red[1];
+                g = cc[cc_slot].green[1];
+                b = cc[cc_slot].blue[1];
             }
 
-            if (chroma_floor && use_color_background) {
+            if (cc_lookup.chroma_floor && use_color_background) {
                 r = chromaColor.red[1];
                 g = chromaColor.green[1];
                 b = chromaColor.blue[1];
             } 
-
-            override_index = 0;
             
             for (int i = 0; i < rsp.current_num_lights - 1; i++) {
                 float intensity = 0;
@@ -890,40 +1795,21 @@ static void gfx_sp_vertex(size_t n_vertices, size_t dest_index, const Vtx *verti
                 intensity += vn->n[2] * rsp.current_lights_coeffs[i][2];
                 intensity /= 127.0f;
                 if (intensity > 0.0f) {
-                    // Light colors
-                    int lightr = rsp.current_lights[i].col[0];
-                    int lightg = rsp.current_lights[i].col[1];
-                    int lightb = rsp.current_lights[i].col[2];
-
-                    // Override these too
-                    if (override_colors) {
-                        if (false); // OVERRIDE_COLOR is an else-if tree
-                        OVERRIDE_COLOR(CC_HAT,             COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_OVERALLS,        COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_GLOVES,          COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_SHOES,           COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_SKIN,            COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_HAIR,            COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_SHIRT,           COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_SHOULDERS,       COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_ARMS,            COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_OVERALLS_BOTTOM, COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_LEG_TOP,         COLOR_MAIN);
-                        OVERRIDE_COLOR(CC_LEG_BOTTOM,      COLOR_MAIN);
-
-                        else if (!(mario_sideburn || chroma_floor)) {
-                            r += intensity * lightr;
-                            g += intensity * lightg;
-                            b += intensity * lightb;
+                    // Light colors, overridden by the color code's
+                    if (cc_slot >= 0) {
+                        if (cc) {
+                            r += intensity * cc[cc_slot].red[0];
+                            g += intensity * cc[cc_slot].green[0];
+                            b += intensity * cc[cc_slot].blue[0];
                         }
                     }
-                    else {
-                        r += intensity * lightr;
-                        g += intensity * lightg;
-                        b += intensity * lightb;
+                    else if (!cc_lookup.override_colors || !(cc_lookup.mario_sideburn || cc_lookup.chroma_floor)) {
+                        r += intensity * rsp.current_lights[i].col[0];
+                        g += intensity * rsp.current_lights[i].col[1];
+                        b += intensity * rsp.current_lights[i].col[2];
                     }
 
-                    if (chroma_floor) {
+                    if (cc_lookup.chroma_floor) {
                         r = chromaColor.red[1];
                         g = chromaColor.green[1];
                         b = chromaColor.blue[1];
@@ -950,6 +1836,10 @@ static void gfx_sp_vertex(size_t n_vertices, size_t dest_index, const Vtx *verti
                 U = (int32_t)((dotx / 127.0f + 1.0f) / 4.0f * rsp.texture_scaling_factor.s);
                 V = (int32_t)((doty / 127.0f + 1.0f) / 4.0f * rsp.texture_scaling_factor.t);
             }
+
+            if (cached) {
+                cached->lit[i] = (struct InstanceLitVertex) { d->color.r, d->color.g, d->color.b, U, V };
+            }
         } else {
             d->color.r = v->cn[0] / (world_light_dir4);
             d->color.g = v->cn[1] / (world_light_dir4);
@@ -959,38 +1849,9 @@ static void gfx_sp_vertex(size_t n_vertices, size_t dest_index, const Vtx *verti
         d->u = U;
         d->v = V;
         
-        // trivial clip rejection
-        d->clip_rej = 0;
-        if (x < -w) d->clip_rej |= 1;
-        if (x > w) d->clip_rej |= 2;
-        if (y < -w) d->clip_rej |= 4;
-        if (y > w) d->clip_rej |= 8;
-        if (z < -w) d->clip_rej |= 16;
-        if (z > w) d->clip_rej |= 32;
-        
-        d->x = x;
-        d->y = y;
-        d->z = z;
-        d->w = w;
-        
+        // positions and the fog factor were filled in by gfx_transform_vertices
         if (rsp.geometry_mode & G_FOG) {
-            if (enable_fog) {
-                if (fabsf(w) < 0.001f) {
-                    // To avoid division by zero
-                    w = 0.001f;
-                }
-                
-                float winv = 1.0f / w;
-                if (winv < 0.0f) {
-                    winv = 32767.0f;
-                }
-                
-                float fog_z = z * winv * rsp.fog_mul + rsp.fog_offset;
-                if (fog_z < 0) fog_z = 0;
-                if (fog_z > 255) fog_z = 255;
-                d->color.a = fog_z; // Use alpha variable to store fog factor
-            }
-            else d->color.a = 0;
+            if (!enable_fog) d->color.a = 0;
         } else {
             d->color.a = v->cn[3];
         }
@@ -1037,39 +1898,8 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
     }
     
     bool depth_test = (rsp.geometry_mode & G_ZBUFFER) == G_ZBUFFER;
-    if (depth_test != rendering_state.depth_test) {
-        gfx_flush();
-        gfx_rapi->set_depth_test(depth_test);
-        rendering_state.depth_test = depth_test;
-    }
-    
     bool z_upd = (rdp.other_mode_l & Z_UPD) == Z_UPD;
-    if (z_upd != rendering_state.depth_mask) {
-        gfx_flush();
-        gfx_rapi->set_depth_mask(z_upd);
-        rendering_state.depth_mask = z_upd;
-    }
-    
     bool zmode_decal = (rdp.other_mode_l & ZMODE_DEC) == ZMODE_DEC;
-    if (zmode_decal != rendering_state.decal_mode) {
-        gfx_flush();
-        gfx_rapi->set_zmode_decal(zmode_decal);
-        rendering_state.decal_mode = zmode_decal;
-    }
-    
-    if (rdp.viewport_or_scissor_changed) {
-        if (memcmp(&rdp.viewport, &rendering_state.viewport, sizeof(rdp.viewport)) != 0) {
-            gfx_flush();
-            gfx_rapi->set_viewport(rdp.viewport.x, rdp.viewport.y, rdp.viewport.width, rdp.viewport.height);
-            rendering_state.viewport = rdp.viewport;
-        }
-        if (memcmp(&rdp.scissor, &rendering_state.scissor, sizeof(rdp.scissor)) != 0) {
-            gfx_flush();
-            gfx_rapi->set_scissor(rdp.scissor.x, rdp.scissor.y, rdp.scissor.width, rdp.scissor.height);
-            rendering_state.scissor = rdp.scissor;
-        }
-        rdp.viewport_or_scissor_changed = false;
-    }
     
     uint32_t cc_id = rdp.combine_mode;
     
@@ -1093,21 +1923,62 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
     
     struct ColorCombiner *comb = gfx_lookup_or_create_color_combiner(cc_id);
     struct ShaderProgram *prg = comb->prg;
-    if (prg != rendering_state.shader_program) {
-        gfx_flush();
-        gfx_rapi->unload_shader(rendering_state.shader_program);
-        gfx_rapi->load_shader(prg);
-        rendering_state.shader_program = prg;
-    }
-    if (use_alpha != rendering_state.alpha_blend) {
-        gfx_flush();
-        gfx_rapi->set_use_alpha(use_alpha);
-        rendering_state.alpha_blend = use_alpha;
+    
+    // Opaque triangles that write depth can be drawn in any order, so they're
+    // collected by state and drawn together before the next one that can't
+    bool deferred = configBatchOpaque && depth_test && z_upd && !zmode_decal && !use_alpha;
+    if (!deferred) {
+        gfx_flush_deferred();
+        if (depth_test != rendering_state.depth_test) {
+            gfx_flush();
+            gfx_rapi->set_depth_test(depth_test);
+            rendering_state.depth_test = depth_test;
+        }
+        
+        if (z_upd != rendering_state.depth_mask) {
+            gfx_flush();
+            gfx_rapi->set_depth_mask(z_upd);
+            rendering_state.depth_mask = z_upd;
+        }
+        
+        if (zmode_decal != rendering_state.decal_mode) {
+            gfx_flush();
+            gfx_rapi->set_zmode_decal(zmode_decal);
+            rendering_state.decal_mode = zmode_decal;
+        }
+        
+        if (rdp.viewport_or_scissor_changed) {
+            if (memcmp(&rdp.viewport, &rendering_state.viewport, sizeof(rdp.viewport)) != 0) {
+                gfx_flush();
+                gfx_rapi->set_viewport(rdp.viewport.x, rdp.viewport.y, rdp.viewport.width, rdp.viewport.height);
+                rendering_state.viewport = rdp.viewport;
+            }
+            if (memcmp(&rdp.scissor, &rendering_state.scissor, sizeof(rdp.scissor)) != 0) {
+                gfx_flush();
+                gfx_rapi->set_scissor(rdp.scissor.x, rdp.scissor.y, rdp.scissor.width, rdp.scissor.height);
+                rendering_state.scissor = rdp.scissor;
+            }
+            rdp.viewport_or_scissor_changed = false;
+        }
+        
+        if (prg != rendering_state.shader_program) {
+            gfx_flush();
+            gfx_rapi->unload_shader(rendering_state.shader_program);
+            gfx_rapi->load_shader(prg);
+            rendering_state.shader_program = prg;
+        }
+        if (use_alpha != rendering_state.alpha_blend) {
+            gfx_flush();
+            gfx_rapi->set_use_alpha(use_alpha);
+            rendering_state.alpha_blend = use_alpha;
+        }
     }
+    
     uint8_t num_inputs;
     bool used_textures[2];
     gfx_rapi->shader_get_info(prg, &num_inputs, used_textures);
     
+    bool linear_filter = configFiltering && ((rdp.other_mode_h & (3U << G_MDSFT_TEXTFILT)) != G_TF_POINT);
     for (int i = 0; i < 2; i++) {
         if (used_textures[i]) {
             if (rdp.textures_changed[i]) {
@@ -1115,7 +1986,7 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
                 import_texture(i);
                 rdp.textures_changed[i] = false;
             }
-            bool linear_filter = configFiltering && ((rdp.other_mode_h & (3U << G_MDSFT_TEXTFILT)) != G_TF_POINT);
+            if (deferred) continue;
             if (linear_filter != rendering_state.textures[i]->linear_filter || rdp.texture_tile.cms != rendering_state.textures[i]->cms || rdp.texture_tile.cmt != rendering_state.textures[i]->cmt) {
                 gfx_flush();
                 gfx_rapi->set_sampler_parameters(i, linear_filter, rdp.texture_tile.cms, rdp.texture_tile.cmt);
@@ -1131,6 +2002,7 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
     uint32_t tex_height = (rdp.texture_tile.lrt - rdp.texture_tile.ult + 4) / 4;
     
     bool z_is_from_0_to_1 = gfx_rapi->z_is_from_0_to_1();
+    size_t buf_vbo_start = buf_vbo_len;
     
     for (int i = 0; i < 3; i++) {
         float z = v_arr[i]->z, w = v_arr[i]->w;
@@ -1209,6 +2081,11 @@ static void gfx_sp_tri1(uint8_t vtx1_idx, uint8_t vtx2_idx, uint8_t vtx3_idx) {
         buf_vbo[buf_vbo_len++] = color->b / 255.0f;
         buf_vbo[buf_vbo_len++] = color->a / 255.0f;*/
     }
+    if (deferred) {
+        gfx_defer_triangle(prg, used_textures, linear_filter, &buf_vbo[buf_vbo_start], buf_vbo_len - buf_vbo_start);
+        buf_vbo_len = buf_vbo_start;
+        return;
+    }
     if (++buf_vbo_num_tris == MAX_BUFFERED) {
         gfx_flush();
     }
@@ -1257,6 +2134,7 @@ static void gfx_sp_movemem(uint8_t index, uint8_t offset, const void* data) {
             if (lightidx >= 0 && lightidx <= MAX_LIGHTS) { // skip lookat
                 // NOTE: reads out of bounds if it is an ambient light
                 memcpy(rsp.current_lights + lightidx, data, sizeof(Light_t));
+                cc_lookup.dirty = true;
             }
             break;
         }
@@ -1266,6 +2144,7 @@ static void gfx_sp_movemem(uint8_t index, uint8_t offset, const void* data) {
         case G_MV_L2:
             // NOTE: reads out of bounds if it is an ambient light
             memcpy(rsp.current_lights + (index - G_MV_L0) / 2, data, sizeof(Light_t));
+            cc_lookup.dirty = true;
             break;
 #endif
     }
@@ -1282,6 +2161,7 @@ static void gfx_sp_moveword(uint8_t index, uint16_t offset, uint32_t data) {
             rsp.current_num_lights = (data - 0x80000000U) / 32;
 #endif
             rsp.lights_changed = 1;
+            cc_lookup.dirty = true;
             break;
         case G_MW_FOG:
             rsp.fog_mul = (int16_t)(data >> 16);
@@ -1659,6 +2539,7 @@ static void gfx_run_dl(Gfx* cmd) {
             // RSP commands:
             case G_SETOBJ:
                 gCurrentObject = (struct Object*)seg_addr(cmd->words.w1);
+                cc_lookup.dirty = true;
                 break;
             case G_MTX:
 #ifdef F3DEX_GBI_2
@@ -1867,6 +2748,7 @@ static void gfx_sp_reset() {
     rsp.modelview_matrix_stack_size = 1;
     rsp.current_num_lights = 2;
     rsp.lights_changed = true;
+    cc_lookup.dirty = true;
 }
 
 void gfx_get_dimensions(uint32_t *width, uint32_t *height) {
@@ -1878,6 +2760,12 @@ void gfx_init(struct GfxWindowManagerAPI *wapi, struct GfxRenderingAPI *rapi, co
     gfx_rapi = rapi;
     gfx_wapi->init(window_title);
     gfx_rapi->init();
+#if HAS_SSE2 || HAS_NEON
+    if (!gfx_transform_vertices_self_test()) {
+        fprintf(stderr, "vector vertex transform doesn't match the scalar one, using the scalar one\n");
+        vertex_simd_enabled = false;
+    }
+#endif
     
     // Used in the 120 star TAS
     static uint32_t precomp_shaders[] = {
@@ -1920,7 +2808,7 @@ void gfx_precache_textures(void) {
     //fs_walk(FS_TEXTUREDIR, preload_texture, NULL, true);
 
     // ...IM CLEARING THE CACHE INSTEAD XDDDDDDDD
-    memset(&gfx_texture_cache, 0, sizeof(gfx_texture_cache));
+    gfx_texture_cache_clear();
 }
 #endif
 
@@ -1943,9 +2831,18 @@ void gfx_start_frame(void) {
     }
 }
 
+static Gfx *record_commands;
+
+static void gfx_run_recorded(void) {
+    gfx_run_dl(record_commands);
+    gfx_flush_deferred();
+    gfx_flush();
+}
+
 void gfx_run(Gfx *commands) {
     if (commands) {
         gfx_sp_reset();
+        instance_cache_frame++;
         
         //puts("New frame");
         
@@ -1957,8 +2854,21 @@ void gfx_run(Gfx *commands) {
         
         double t0 = gfx_wapi->get_time();
         gfx_rapi->start_frame();
-        gfx_run_dl(commands);
-        gfx_flush();
+#ifdef EXTERNAL_DATA
+        gfx_upload_streamed_textures();
+#endif
+        if (configThreadedGfx) {
+            // interpret on the recording thread, submit here as commands come in
+            struct GfxRenderingAPI *backend = gfx_rapi;
+            record_commands = commands;
+            gfx_rapi = gfx_record_begin(backend);
+            gfx_record_run(gfx_run_recorded);
+            gfx_rapi = backend;
+        } else {
+            gfx_run_dl(commands);
+            gfx_flush_deferred();
+            gfx_flush();
+        }
         double t1 = gfx_wapi->get_time();
         //printf("Process %f %f\n", t1, t1 - t0);
     }
@@ -1974,6 +2884,9 @@ void gfx_end_frame(void) {
 }
 
 void gfx_shutdown(void) {
+#ifdef EXTERNAL_DATA
+    gfx_texture_pack_cache_flush();
+#endif
     if (gfx_rapi) {
         if (gfx_rapi->shutdown) gfx_rapi->shutdown();
         gfx_rapi = NULL;
@@ -13,6 +13,12 @@ struct GfxDimensions {
 
 extern struct GfxDimensions gfx_current_dimensions;
 
+struct GfxTextureCacheStats {
+    uint64_t hits, misses, evictions;
+    uint64_t bytes_used, bytes_budget;
+    uint32_t entries;
+};
+
 #ifdef __cplusplus
 extern float world_light_dir1;
 extern float world_light_dir2;
@@ -31,12 +37,15 @@ void gfx_start_frame(void);
 void gfx_run(Gfx *commands);
 void gfx_end_frame(void);
 void gfx_precache_textures(void);
+void gfx_get_texture_cache_stats(struct GfxTextureCacheStats *stats);
+void gfx_set_projection_tile(float scale_x, float scale_y, float offset_x, float offset_y);
 void gfx_shutdown(void);
 
+void gfx_precache_textures_with_progress(bool level_only, void (*progress)(int done, int total));
+
 extern int preloaded_textures_count;
 
 extern void load_texture(const char*);
-extern bool preload_texture(void *, const char *);
 
 #ifdef __cplusplus
 }
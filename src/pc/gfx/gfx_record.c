@@ -0,0 +1,401 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "macros.h"
+#include "../platform.h"
+#include "gfx_record.h"
+
+// Display list recording
+// Lets gfx_pc interpret display lists on a worker thread while the thread that
+// owns the graphics context submits the result. Rendering API calls are
+// appended to a ring of command blocks and replayed as soon as they're
+// published. Creating shaders and textures needs the real backend, so those
+// calls wait until the submitting thread has gotten to them.
+
+#define RECORD_BLOCK_SIZE (4 * 1024 * 1024)
+#define RECORD_BLOCKS 8
+
+enum RecordOp {
+    RECORD_UNLOAD_SHADER,
+    RECORD_LOAD_SHADER,
+    RECORD_CREATE_SHADER,
+    RECORD_NEW_TEXTURE,
+    RECORD_SELECT_TEXTURE,
+    RECORD_UPLOAD_TEXTURE,
+    RECORD_SAMPLER_PARAMETERS,
+    RECORD_DEPTH_TEST,
+    RECORD_DEPTH_MASK,
+    RECORD_ZMODE_DECAL,
+    RECORD_VIEWPORT,
+    RECORD_SCISSOR,
+    RECORD_USE_ALPHA,
+    RECORD_DRAW_TRIANGLES,
+    RECORD_SKIP, // the rest of the block is unused
+    RECORD_END,
+};
+
+struct RecordCommand {
+    uint32_t op;
+    uint32_t size; // including the data following the command
+    union {
+        struct ShaderProgram *prg;
+        uint32_t shader_id;
+        bool enable;
+        int rect[4];
+        struct { int tile; uint32_t texture_id; } select;
+        struct { uint8_t *rgba32_buf; int width, height; } upload;
+        struct { int sampler; bool linear_filter; uint32_t cms, cmt; } sampler;
+        struct { size_t len, num_tris; } draw; // len floats follow
+    } u;
+};
+
+static struct GfxRenderingAPI *record_backend;
+static bool record_z_range;
+
+static uint8_t *record_blocks[RECORD_BLOCKS];
+static size_t record_write; // only touched by the recording thread
+static size_t record_consumed_seen;
+
+// guarded by record_mutex
+static size_t record_published;
+static size_t record_consumed;
+static bool record_sync_done;
+static union {
+    struct ShaderProgram *prg;
+    uint32_t texture_id;
+} record_sync_result;
+static void (*record_job)(void);
+
+static pthread_mutex_t record_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t record_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t record_thread;
+static bool record_thread_started;
+
+static struct RecordCommand *record_at(size_t pos) {
+    return (struct RecordCommand *)(record_blocks[(pos / RECORD_BLOCK_SIZE) % RECORD_BLOCKS] + pos % RECORD_BLOCK_SIZE);
+}
+
+static void record_publish(void) {
+    pthread_mutex_lock(&record_mutex);
+    record_published = record_write;
+    pthread_cond_broadcast(&record_cond);
+    pthread_mutex_unlock(&record_mutex);
+}
+
+static struct RecordCommand *record_alloc(uint32_t op, size_t extra) {
+    size_t size = (sizeof(struct RecordCommand) + extra + 15) & ~(size_t)15;
+    if (size > RECORD_BLOCK_SIZE) sys_fatal("recorded command too large (%u bytes)", (unsigned)size);
+
+    size_t offset = record_write % RECORD_BLOCK_SIZE;
+    if (offset + size > RECORD_BLOCK_SIZE) {
+        struct RecordCommand *skip = record_at(record_write);
+        skip->op = RECORD_SKIP;
+        skip->size = RECORD_BLOCK_SIZE - offset;
+        record_write += skip->size;
+    }
+
+    // wait for the submitting thread to be done with the block we're about to reuse
+    if (record_write + size - record_consumed_seen > RECORD_BLOCKS * RECORD_BLOCK_SIZE) {
+        record_publish();
+        pthread_mutex_lock(&record_mutex);
+        while (record_write + size - record_consumed > RECORD_BLOCKS * RECORD_BLOCK_SIZE) {
+            pthread_cond_wait(&record_cond, &record_mutex);
+        }
+        record_consumed_seen = record_consumed;
+        pthread_mutex_unlock(&record_mutex);
+    }
+
+    struct RecordCommand *cmd = record_at(record_write);
+    cmd->op = op;
+    cmd->size = size;
+    record_write += size;
+    return cmd;
+}
+
+// publishes everything so far and waits for the submitting thread to run it
+static void record_sync(void) {
+    pthread_mutex_lock(&record_mutex);
+    record_sync_done = false;
+    record_published = record_write;
+    pthread_cond_broadcast(&record_cond);
+    while (!record_sync_done) pthread_cond_wait(&record_cond, &record_mutex);
+    pthread_mutex_unlock(&record_mutex);
+}
+
+static void record_sync_finish(void) {
+    pthread_mutex_lock(&record_mutex);
+    record_sync_done = true;
+    pthread_cond_broadcast(&record_cond);
+    pthread_mutex_unlock(&record_mutex);
+}
+
+static bool record_z_is_from_0_to_1(void) {
+    return record_z_range;
+}
+
+static void record_unload_shader(struct ShaderProgram *old_prg) {
+    record_alloc(RECORD_UNLOAD_SHADER, 0)->u.prg = old_prg;
+}
+
+static void record_load_shader(struct ShaderProgram *new_prg) {
+    record_alloc(RECORD_LOAD_SHADER, 0)->u.prg = new_prg;
+}
+
+static struct ShaderProgram *record_create_and_load_new_shader(uint32_t shader_id) {
+    record_alloc(RECORD_CREATE_SHADER, 0)->u.shader_id = shader_id;
+    record_sync();
+    return record_sync_result.prg;
+}
+
+// shader lookups only read what the backend filled in when it created them,
+// and creating one waits for the recording thread, so these can run directly
+static struct ShaderProgram *record_lookup_shader(uint32_t shader_id) {
+    return record_backend->lookup_shader(shader_id);
+}
+
+static void record_shader_get_info(struct ShaderProgram *prg, uint8_t *num_inputs, bool used_textures[2]) {
+    record_backend->shader_get_info(prg, num_inputs, used_textures);
+}
+
+static uint32_t record_new_texture(void) {
+    record_alloc(RECORD_NEW_TEXTURE, 0);
+    record_sync();
+    return record_sync_result.texture_id;
+}
+
+static void record_select_texture(int tile, uint32_t texture_id) {
+    struct RecordCommand *cmd = record_alloc(RECORD_SELECT_TEXTURE, 0);
+    cmd->u.select.tile = tile;
+    cmd->u.select.texture_id = texture_id;
+}
+
+static void record_upload_texture(const uint8_t *rgba32_buf, int width, int height) {
+    // texture buffers can be bigger than a block, so they're copied on their own
+    uint8_t *copy = malloc((size_t)width * height * 4);
+    if (!copy) sys_fatal("out of memory recording a %dx%d texture", width, height);
+    memcpy(copy, rgba32_buf, (size_t)width * height * 4);
+    struct RecordCommand *cmd = record_alloc(RECORD_UPLOAD_TEXTURE, 0);
+    cmd->u.upload.rgba32_buf = copy;
+    cmd->u.upload.width = width;
+    cmd->u.upload.height = height;
+}
+
+static void record_set_sampler_parameters(int sampler, bool linear_filter, uint32_t cms, uint32_t cmt) {
+    struct RecordCommand *cmd = record_alloc(RECORD_SAMPLER_PARAMETERS, 0);
+    cmd->u.sampler.sampler = sampler;
+    cmd->u.sampler.linear_filter = linear_filter;
+    cmd->u.sampler.cms = cms;
+    cmd->u.sampler.cmt = cmt;
+}
+
+static void record_set_depth_test(bool depth_test) {
+    record_alloc(RECORD_DEPTH_TEST, 0)->u.enable = depth_test;
+}
+
+static void record_set_depth_mask(bool z_upd) {
+    record_alloc(RECORD_DEPTH_MASK, 0)->u.enable = z_upd;
+}
+
+static void record_set_zmode_decal(bool zmode_decal) {
+    record_alloc(RECORD_ZMODE_DECAL, 0)->u.enable = zmode_decal;
+}
+
+static void record_set_rect(uint32_t op, int x, int y, int width, int height) {
+    struct RecordCommand *cmd = record_alloc(op, 0);
+    cmd->u.rect[0] = x;
+    cmd->u.rect[1] = y;
+    cmd->u.rect[2] = width;
+    cmd->u.rect[3] = height;
+}
+
+static void record_set_viewport(int x, int y, int width, int height) {
+    record_set_rect(RECORD_VIEWPORT, x, y, width, height);
+}
+
+static void record_set_scissor(int x, int y, int width, int height) {
+    record_set_rect(RECORD_SCISSOR, x, y, width, height);
+}
+
+static void record_set_use_alpha(bool use_alpha) {
+    record_alloc(RECORD_USE_ALPHA, 0)->u.enable = use_alpha;
+}
+
+static void record_draw_triangles(float buf_vbo[], size_t buf_vbo_len, size_t buf_vbo_num_tris) {
+    struct RecordCommand *cmd = record_alloc(RECORD_DRAW_TRIANGLES, buf_vbo_len * sizeof(float));
+    cmd->u.draw.len = buf_vbo_len;
+    cmd->u.draw.num_tris = buf_vbo_num_tris;
+    memcpy(cmd + 1, buf_vbo, buf_vbo_len * sizeof(float));
+    // state changes are only needed once something is drawn, so they go out with draws
+    record_publish();
+}
+
+// everything else only happens outside of recording
+static void record_init(void) {
+    record_backend->init();
+}
+
+static void record_on_resize(void) {
+    record_backend->on_resize();
+}
+
+static void record_start_frame(void) {
+    record_backend->start_frame();
+}
+
+static void record_end_frame(void) {
+    record_backend->end_frame();
+}
+
+static void record_finish_render(void) {
+    record_backend->finish_render();
+}
+
+static void record_shutdown(void) {
+    record_backend->shutdown();
+}
+
+static struct GfxRenderingAPI gfx_record_api = {
+    record_z_is_from_0_to_1,
+    record_unload_shader,
+    record_load_shader,
+    record_create_and_load_new_shader,
+    record_lookup_shader,
+    record_shader_get_info,
+    record_new_texture,
+    record_select_texture,
+    record_upload_texture,
+    record_set_sampler_parameters,
+    record_set_depth_test,
+    record_set_depth_mask,
+    record_set_zmode_decal,
+    record_set_viewport,
+    record_set_scissor,
+    record_set_use_alpha,
+    record_draw_triangles,
+    record_init,
+    record_on_resize,
+    record_start_frame,
+    record_end_frame,
+    record_finish_render,
+    record_shutdown
+};
+
+static void *record_thread_main(UNUSED void *arg) {
+    pthread_mutex_lock(&record_mutex);
+    for (;;) {
+        while (!record_job) pthread_cond_wait(&record_cond, &record_mutex);
+        void (*job)(void) = record_job;
+        record_job = NULL;
+        pthread_mutex_unlock(&record_mutex);
+
+        job();
+        record_alloc(RECORD_END, 0);
+        record_publish();
+
+        pthread_mutex_lock(&record_mutex);
+    }
+    return NULL;
+}
+
+struct GfxRenderingAPI *gfx_record_begin(struct GfxRenderingAPI *backend) {
+    record_backend = backend;
+    record_z_range = backend->z_is_from_0_to_1();
+    return &gfx_record_api;
+}
+
+// runs recorded commands up to end, returns false once the end of the recording was reached
+static bool record_submit(size_t *pos, size_t end) {
+    while (*pos < end) {
+        struct RecordCommand *cmd = record_at(*pos);
+        *pos += cmd->size;
+        switch (cmd->op) {
+            case RECORD_UNLOAD_SHADER:
+                record_backend->unload_shader(cmd->u.prg);
+                break;
+            case RECORD_LOAD_SHADER:
+                record_backend->load_shader(cmd->u.prg);
+                break;
+            case RECORD_CREATE_SHADER:
+                record_sync_result.prg = record_backend->create_and_load_new_shader(cmd->u.shader_id);
+                record_sync_finish();
+                break;
+            case RECORD_NEW_TEXTURE:
+                record_sync_result.texture_id = record_backend->new_texture();
+                record_sync_finish();
+                break;
+            case RECORD_SELECT_TEXTURE:
+                record_backend->select_texture(cmd->u.select.tile, cmd->u.select.texture_id);
+                break;
+            case RECORD_UPLOAD_TEXTURE:
+                record_backend->upload_texture(cmd->u.upload.rgba32_buf, cmd->u.upload.width, cmd->u.upload.height);
+                free(cmd->u.upload.rgba32_buf);
+                break;
+            case RECORD_SAMPLER_PARAMETERS:
+                record_backend->set_sampler_parameters(cmd->u.sampler.sampler, cmd->u.sampler.linear_filter, cmd->u.sampler.cms, cmd->u.sampler.cmt);
+                break;
+            case RECORD_DEPTH_TEST:
+                record_backend->set_depth_test(cmd->u.enable);
+                break;
+            case RECORD_DEPTH_MASK:
+                record_backend->set_depth_mask(cmd->u.enable);
+                break;
+            case RECORD_ZMODE_DECAL:
+                record_backend->set_zmode_decal(cmd->u.enable);
+                break;
+            case RECORD_VIEWPORT:
+                record_backend->set_viewport(cmd->u.rect[0], cmd->u.rect[1], cmd->u.rect[2], cmd->u.rect[3]);
+                break;
+            case RECORD_SCISSOR:
+                record_backend->set_scissor(cmd->u.rect[0], cmd->u.rect[1], cmd->u.rect[2], cmd->u.rect[3]);
+                break;
+            case RECORD_USE_ALPHA:
+                record_backend->set_use_alpha(cmd->u.enable);
+                break;
+            case RECORD_DRAW_TRIANGLES:
+                record_backend->draw_triangles((float *)(cmd + 1), cmd->u.draw.len, cmd->u.draw.num_tris);
+                break;
+            case RECORD_SKIP:
+                break;
+            case RECORD_END:
+                return false;
+        }
+    }
+    return true;
+}
+
+void gfx_record_run(void (*record)(void)) {
+    if (!record_thread_started) {
+        for (int i = 0; i < RECORD_BLOCKS; i++) {
+            record_blocks[i] = malloc(RECORD_BLOCK_SIZE);
+            if (!record_blocks[i]) sys_fatal("out of memory for display list recording");
+        }
+        // display lists nest, so give the interpreter the stack it'd have on the main thread
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, 8 * 1024 * 1024);
+        if (pthread_create(&record_thread, &attr, record_thread_main, NULL) != 0) sys_fatal("could not start the display list thread");
+        pthread_attr_destroy(&attr);
+        record_thread_started = true;
+    }
+
+    // both threads are idle in between frames, start over at the first block
+    pthread_mutex_lock(&record_mutex);
+    record_write = record_consumed_seen = 0;
+    record_published = record_consumed = 0;
+    record_job = record;
+    pthread_cond_broadcast(&record_cond);
+    pthread_mutex_unlock(&record_mutex);
+
+    size_t pos = 0;
+    bool running = true;
+    while (running) {
+        pthread_mutex_lock(&record_mutex);
+        record_consumed = pos;
+        pthread_cond_broadcast(&record_cond);
+        while (record_published == pos) pthread_cond_wait(&record_cond, &record_mutex);
+        size_t end = record_published;
+        pthread_mutex_unlock(&record_mutex);
+        running = record_submit(&pos, end);
+    }
+}
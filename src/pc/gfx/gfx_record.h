@@ -0,0 +1,14 @@
+#ifndef GFX_RECORD_H
+#define GFX_RECORD_H
+
+#include "gfx_rendering_api.h"
+
+// Returns a rendering API that records calls into a command buffer instead of
+// making them. Recorded commands are submitted to backend by gfx_record_run.
+struct GfxRenderingAPI *gfx_record_begin(struct GfxRenderingAPI *backend);
+
+// Calls record on a worker thread, submitting what it records to the backend
+// on the calling thread as it comes in. Returns once everything is submitted.
+void gfx_record_run(void (*record)(void));
+
+#endif
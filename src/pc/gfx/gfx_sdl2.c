@@ -246,7 +246,7 @@ static void gfx_sdl_init(const char *window_title) {
     wnd = SDL_CreateWindow(
         window_title,
         xpos, ypos, configWindow.w, configWindow.h,
-        SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE
+        SDL_WINDOW_OPENGL | (gCLIOpts.RenderProject[0] ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN) | SDL_WINDOW_RESIZABLE
     );
     ctx = SDL_GL_CreateContext(wnd);
 
@@ -404,7 +404,18 @@ static inline void sync_framerate_with_timer(void) {
 }
 
 static void gfx_sdl_swap_buffers_begin(void) {
-    if (use_timer) sync_framerate_with_timer();
+    // offline renders skip the frame limiter and vsync, and restore them once done
+    static bool offline = false;
+    static int swap_interval;
+    if (saturn_imgui_is_rendering_offline() != offline) {
+        offline = !offline;
+        if (offline) {
+            swap_interval = SDL_GL_GetSwapInterval();
+            SDL_GL_SetSwapInterval(0);
+        }
+        else SDL_GL_SetSwapInterval(swap_interval);
+    }
+    if (use_timer && !offline) sync_framerate_with_timer();
     SDL_GL_SwapWindow(wnd);
 }
 
@@ -0,0 +1,504 @@
+#ifdef EXTERNAL_DATA
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "macros.h"
+#include "../platform.h"
+#include "../configfile.h"
+#include "../fs/fs.h"
+#include "pc/pngutils.h"
+#include "gfx_texture_pack_cache.h"
+
+// Decoded texture cache
+// Each texture pack (the base textures in gfx, and every folder in
+// dynos/textures) gets a file in the write path holding its textures already
+// decoded to RGBA32, so loading them again is a copy instead of a PNG decode.
+// Entries remember the size and modification time of the PNG they came from
+// and are ignored once it changes.
+//
+// The file is memory mapped. Pixel data comes first, then the index sorted by
+// name, the names, and a footer pointing at the index. Flushing appends the
+// new textures and a new index after the old footer, so bytes another process
+// already mapped never change. Once enough of the file is superseded pixels
+// and old indexes it's written again without them instead. Writers hold an exclusive lock on a lock file
+// next to the cache, mapping takes a shared one so a half written tail is
+// never seen. A damaged file is replaced through a temporary file instead.
+// Every entry carries a checksum of its pixels, checked when it's read.
+
+#define PACK_CACHE_MAGIC "SATTEX02"
+#define PACK_CACHE_FOLDER "texture_cache"
+#define PACK_CACHE_DYNOS_TEXTURES "../dynos/textures/" // see saturn_get_textures_folder
+#define PACK_CACHE_MAX_PACKS 32
+#define PACK_CACHE_FLUSH_BYTES (64 * 1024 * 1024)
+#define PACK_CACHE_COMPACT_BYTES (64 * 1024 * 1024)
+
+struct PackCacheEntry {
+    uint64_t data_offset;
+    int64_t src_size, src_mtime;
+    uint32_t name_offset;
+    uint32_t width, height;
+    uint32_t checksum;
+};
+
+struct PackCacheFooter {
+    uint64_t index_offset;
+    uint32_t count;
+    uint32_t names_size;
+    char magic[8];
+};
+
+struct PendingTexture {
+    struct PendingTexture *next;
+    char *name;
+    int64_t src_size, src_mtime;
+    uint32_t width, height;
+    uint8_t *pixels;
+};
+
+struct PackCache {
+    char folder[SYS_MAX_PATH];
+    char file[SYS_MAX_PATH];
+    const uint8_t *map;
+    size_t map_size;
+    const struct PackCacheEntry *entries;
+    const char *names;
+    uint32_t count;
+    struct PendingTexture *pending;
+    size_t pending_bytes;
+};
+
+// guarded by pack_cache_mutex, texture loads come from the streaming threads too
+static struct PackCache pack_caches[PACK_CACHE_MAX_PACKS];
+static int pack_cache_count;
+static pthread_mutex_t pack_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void pack_cache_unmap(struct PackCache *pack) {
+    if (pack->map) {
+#ifdef _WIN32
+        UnmapViewOfFile(pack->map);
+#else
+        munmap((void *)pack->map, pack->map_size);
+#endif
+    }
+    pack->map = NULL;
+    pack->map_size = 0;
+    pack->entries = NULL;
+    pack->names = NULL;
+    pack->count = 0;
+}
+
+// Locks the pack's cache against other processes, returns a handle for pack_cache_unlock
+static intptr_t pack_cache_lock(struct PackCache *pack, bool exclusive) {
+    char dir[SYS_MAX_PATH], path[SYS_MAX_PATH];
+    snprintf(dir, sizeof(dir), "%s/" PACK_CACHE_FOLDER, fs_writepath);
+    if (!fs_sys_dir_exists(dir)) fs_sys_mkdir(dir);
+    snprintf(path, sizeof(path), "%s.lock", pack->file);
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return -1;
+    OVERLAPPED overlapped = { 0 };
+    if (!LockFileEx(file, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, 1, 0, &overlapped)) {
+        CloseHandle(file);
+        return -1;
+    }
+    return (intptr_t)file;
+#else
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (fd < 0) return -1;
+    if (flock(fd, exclusive ? LOCK_EX : LOCK_SH) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#endif
+}
+
+static void pack_cache_unlock(intptr_t lock) {
+    if (lock == -1) return;
+#ifdef _WIN32
+    OVERLAPPED overlapped = { 0 };
+    UnlockFileEx((HANDLE)lock, 0, 1, 0, &overlapped);
+    CloseHandle((HANDLE)lock);
+#else
+    flock(lock, LOCK_UN);
+    close(lock);
+#endif
+}
+
+static uint32_t pack_cache_checksum(const uint8_t *pixels, size_t size) {
+    // FNV-1a over 64 bit words
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, pixels + i, 8);
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    for (; i < size; i++) hash = (hash ^ pixels[i]) * 0x100000001b3ULL;
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+// Call with the pack locked
+static void pack_cache_map(struct PackCache *pack) {
+    pack_cache_unmap(pack);
+#ifdef _WIN32
+    // others have to be able to append, and replace the file if it's damaged
+    HANDLE file = CreateFileA(pack->file, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping) {
+        pack->map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        pack->map_size = (size_t)size.QuadPart;
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    int fd = open(pack->file, O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            pack->map = map;
+            pack->map_size = st.st_size;
+        }
+    }
+    close(fd);
+#endif
+    if (!pack->map) return;
+
+    // anything that doesn't add up is thrown away and written over on the next flush
+    struct PackCacheFooter footer;
+    if (pack->map_size < sizeof(footer)) goto _invalid;
+    memcpy(&footer, pack->map + pack->map_size - sizeof(footer), sizeof(footer));
+    if (memcmp(footer.magic, PACK_CACHE_MAGIC, sizeof(footer.magic))) goto _invalid;
+    if (footer.index_offset + (uint64_t)footer.count * sizeof(struct PackCacheEntry) + footer.names_size + sizeof(footer) != pack->map_size) goto _invalid;
+    if (footer.index_offset % 8 != 0) goto _invalid; // the entries are read in place
+
+    pack->entries = (const struct PackCacheEntry *)(pack->map + footer.index_offset);
+    pack->names = (const char *)(pack->entries + footer.count);
+    pack->count = footer.count;
+    for (uint32_t i = 0; i < pack->count; i++) {
+        const struct PackCacheEntry *entry = &pack->entries[i];
+        if (entry->name_offset >= footer.names_size || entry->data_offset + (uint64_t)entry->width * entry->height * 4 > footer.index_offset) goto _invalid;
+    }
+    if (footer.names_size > 0 && pack->names[footer.names_size - 1] != 0) goto _invalid;
+    return;
+
+_invalid:
+    fprintf(stderr, "texture cache `%s` is damaged, it'll be rebuilt\n", pack->file);
+    pack_cache_unmap(pack);
+}
+
+// Finds the pack path belongs to, pointing name at the rest of the path
+static struct PackCache *pack_cache_for(const char *path, const char **name) {
+    size_t folder_len;
+    if (!strncmp(path, FS_TEXTUREDIR "/", sizeof(FS_TEXTUREDIR))) {
+        folder_len = sizeof(FS_TEXTUREDIR) - 1;
+    } else if (!strncmp(path, PACK_CACHE_DYNOS_TEXTURES, sizeof(PACK_CACHE_DYNOS_TEXTURES) - 1)) {
+        const char *slash = strchr(path + sizeof(PACK_CACHE_DYNOS_TEXTURES) - 1, '/');
+        if (!slash) return NULL;
+        folder_len = slash - path;
+    } else {
+        return NULL;
+    }
+    if (folder_len >= SYS_MAX_PATH) return NULL;
+    *name = path + folder_len + 1;
+
+    for (int i = 0; i < pack_cache_count; i++) {
+        if (!strncmp(pack_caches[i].folder, path, folder_len) && pack_caches[i].folder[folder_len] == 0) return &pack_caches[i];
+    }
+    if (pack_cache_count == PACK_CACHE_MAX_PACKS) return NULL;
+
+    struct PackCache *pack = &pack_caches[pack_cache_count++];
+    memcpy(pack->folder, path, folder_len);
+    pack->folder[folder_len] = 0;
+
+    // gfx -> gfx.bin, ../dynos/textures/Some Pack -> dynos_textures_Some_Pack.bin
+    char filename[SYS_MAX_PATH];
+    const char *src = pack->folder;
+    while (*src == '.' || *src == '/') src++;
+    size_t len = 0;
+    for (; *src && len < sizeof(filename) - 5; src++) filename[len++] = isalnum((unsigned char)*src) ? *src : '_';
+    filename[len] = 0;
+    snprintf(pack->file, sizeof(pack->file), "%s/" PACK_CACHE_FOLDER "/%s.bin", fs_writepath, filename);
+    intptr_t lock = pack_cache_lock(pack, false);
+    pack_cache_map(pack);
+    pack_cache_unlock(lock);
+    return pack;
+}
+
+// key is { name, the pack's names }
+static int pack_cache_compare(const void *key, const void *entry) {
+    return strcmp(((const char **)key)[0], ((const char **)key)[1] + ((const struct PackCacheEntry *)entry)->name_offset);
+}
+
+static uint8_t *pack_cache_find(struct PackCache *pack, const char *name, int64_t src_size, int64_t src_mtime, int *width, int *height) {
+    const char *key[2] = { name, pack->names };
+    const struct PackCacheEntry *entry = pack->count ? bsearch(key, pack->entries, pack->count, sizeof(*entry), pack_cache_compare) : NULL;
+    if (!entry || entry->src_size != src_size || entry->src_mtime != src_mtime) return NULL;
+
+    size_t size = (size_t)entry->width * entry->height * 4;
+    uint8_t *pixels = malloc(size);
+    if (!pixels) return NULL;
+    memcpy(pixels, pack->map + entry->data_offset, size);
+    if (pack_cache_checksum(pixels, size) != entry->checksum) {
+        fprintf(stderr, "texture cache `%s` has a damaged copy of `%s`, decoding it again\n", pack->file, name);
+        free(pixels);
+        return NULL;
+    }
+    *width = entry->width;
+    *height = entry->height;
+    return pixels;
+}
+
+struct PackCacheIndexEntry {
+    const char *name;
+    struct PackCacheEntry entry;
+    const uint8_t *pixels; // data that still has to be written
+    uint64_t mapped_offset; // where an entry that's already in the file has its data
+    int order;
+};
+
+static int pack_cache_index_compare(const void *a, const void *b) {
+    const struct PackCacheIndexEntry *x = a, *y = b;
+    int cmp = strcmp(x->name, y->name);
+    if (cmp) return cmp;
+    return x->order - y->order;
+}
+
+// index is sorted, a later copy of the same texture wins
+static bool pack_cache_superseded(const struct PackCacheIndexEntry *index, size_t count, size_t i) {
+    return i + 1 < count && !strcmp(index[i].name, index[i + 1].name);
+}
+
+// Writes the index, names and footer for sorted entries, with superseded ones skipped
+static void pack_cache_write_index(FILE *f, struct PackCacheIndexEntry *index, size_t count, uint64_t index_offset) {
+    struct PackCacheFooter footer = { index_offset, 0, 0, PACK_CACHE_MAGIC };
+    for (size_t i = 0; i < count; i++) {
+        if (pack_cache_superseded(index, count, i)) continue;
+        index[i].entry.name_offset = footer.names_size;
+        footer.names_size += strlen(index[i].name) + 1;
+        fwrite(&index[i].entry, sizeof(index[i].entry), 1, f);
+        footer.count++;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (pack_cache_superseded(index, count, i)) continue;
+        fwrite(index[i].name, strlen(index[i].name) + 1, 1, f);
+    }
+    fwrite(&footer, sizeof(footer), 1, f);
+}
+
+// Writes the entries with pixels and then the index, appended to the mapped
+// file, or into a new file that replaces it. Call with the pack locked.
+static bool pack_cache_write(struct PackCache *pack, struct PackCacheIndexEntry *index, size_t count, bool append) {
+    uint64_t data_end = append ? pack->map_size : 0;
+    char tmp[SYS_MAX_PATH];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", pack->file);
+    FILE *f = fopen(append ? pack->file : tmp, append ? "r+b" : "wb");
+    if (f && append && fseek(f, data_end, SEEK_SET) != 0) {
+        fclose(f);
+        f = NULL;
+    }
+    if (!f) {
+        fprintf(stderr, "could not open texture cache `%s` for writing\n", pack->file);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!index[i].pixels || pack_cache_superseded(index, count, i)) continue;
+        index[i].entry.data_offset = data_end;
+        size_t size = (size_t)index[i].entry.width * index[i].entry.height * 4;
+        fwrite(index[i].pixels, size, 1, f);
+        data_end += size;
+    }
+    // the index is read in place from the mapping, so it starts 8 byte aligned
+    static const uint8_t padding[8] = { 0 };
+    size_t pad = (8 - data_end % 8) % 8;
+    if (pad) fwrite(padding, pad, 1, f);
+    data_end += pad;
+    pack_cache_write_index(f, index, count, data_end);
+    bool failed = ferror(f) != 0;
+    failed = fclose(f) != 0 || failed;
+    if (!failed && !append) {
+        // our own mapping of the old file would keep it from being replaced on Windows
+        pack_cache_unmap(pack);
+#ifdef _WIN32
+        // fails while another process has the old file mapped
+        failed = !MoveFileExA(tmp, pack->file, MOVEFILE_REPLACE_EXISTING);
+#else
+        failed = rename(tmp, pack->file) != 0;
+#endif
+    }
+    if (failed) {
+        fprintf(stderr, "could not write texture cache `%s`\n", pack->file);
+        if (!append) remove(tmp);
+    }
+    return !failed;
+}
+
+static void pack_cache_free_pending(struct PackCache *pack) {
+    while (pack->pending) {
+        struct PendingTexture *tex = pack->pending;
+        pack->pending = tex->next;
+        free(tex->name);
+        free(tex->pixels);
+        free(tex);
+    }
+    pack->pending_bytes = 0;
+}
+
+static void pack_cache_flush(struct PackCache *pack) {
+    if (!pack->pending) return;
+
+    // other processes may have added textures since the file was mapped, so map it again once it's ours
+    intptr_t lock = pack_cache_lock(pack, true);
+    if (lock == -1) {
+        fprintf(stderr, "could not lock texture cache `%s`\n", pack->file);
+        pack_cache_free_pending(pack);
+        return;
+    }
+    pack_cache_map(pack);
+
+    size_t count = pack->count;
+    for (struct PendingTexture *tex = pack->pending; tex; tex = tex->next) count++;
+    struct PackCacheIndexEntry *index = calloc(count, sizeof(*index));
+    if (!index) sys_fatal("out of memory writing texture cache");
+    size_t n = 0;
+    int mapped_count = pack->count;
+    for (uint32_t i = 0; i < pack->count; i++, n++) {
+        index[n].name = sys_strdup(pack->names + pack->entries[i].name_offset);
+        index[n].entry = pack->entries[i];
+        index[n].mapped_offset = pack->entries[i].data_offset;
+        index[n].order = n;
+    }
+    for (struct PendingTexture *tex = pack->pending; tex; tex = tex->next, n++) {
+        index[n].name = sys_strdup(tex->name);
+        index[n].entry.src_size = tex->src_size;
+        index[n].entry.src_mtime = tex->src_mtime;
+        index[n].entry.width = tex->width;
+        index[n].entry.height = tex->height;
+        index[n].entry.checksum = pack_cache_checksum(tex->pixels, (size_t)tex->width * tex->height * 4);
+        index[n].pixels = tex->pixels;
+        index[n].order = n; // pending ones were decoded later, they win over old entries
+    }
+    qsort(index, count, sizeof(*index), pack_cache_index_compare);
+
+    // a valid file is appended to, anything else is replaced as a whole
+    bool written = false;
+    if (pack->map) {
+        // everything in the file but the pixels of entries that are kept is dead weight
+        uint64_t live = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (index[i].order < mapped_count && !pack_cache_superseded(index, count, i)) {
+                live += (uint64_t)index[i].entry.width * index[i].entry.height * 4;
+            }
+        }
+        uint64_t dead = pack->map_size - live;
+        if (dead >= PACK_CACHE_COMPACT_BYTES || dead > live) {
+            for (size_t i = 0; i < count; i++) {
+                if (index[i].order < mapped_count) index[i].pixels = pack->map + index[i].mapped_offset;
+            }
+            written = pack_cache_write(pack, index, count, false);
+            if (!written) {
+                // append instead, the old file is unchanged
+                for (size_t i = 0; i < count; i++) {
+                    if (index[i].order >= mapped_count) continue;
+                    index[i].pixels = NULL;
+                    index[i].entry.data_offset = index[i].mapped_offset;
+                }
+                pack_cache_map(pack);
+            }
+        }
+    }
+    // old entries can't be kept if the file couldn't be mapped again
+    if (!written && (pack->map || mapped_count == 0)) pack_cache_write(pack, index, count, pack->map != NULL);
+
+    for (size_t i = 0; i < count; i++) free((void *)index[i].name);
+    free(index);
+    pack_cache_free_pending(pack);
+    pack_cache_map(pack);
+    pack_cache_unlock(lock);
+}
+
+static void pack_cache_add(struct PackCache *pack, const char *name, int64_t src_size, int64_t src_mtime, const uint8_t *pixels, int width, int height) {
+    size_t size = (size_t)width * height * 4;
+    struct PendingTexture *tex = calloc(1, sizeof(*tex));
+    if (!tex) return;
+    tex->name = sys_strdup(name);
+    tex->pixels = malloc(size);
+    if (!tex->name || !tex->pixels) {
+        free(tex->name);
+        free(tex->pixels);
+        free(tex);
+        return;
+    }
+    memcpy(tex->pixels, pixels, size);
+    tex->src_size = src_size;
+    tex->src_mtime = src_mtime;
+    tex->width = width;
+    tex->height = height;
+    tex->next = pack->pending;
+    pack->pending = tex;
+    pack->pending_bytes += size;
+    if (pack->pending_bytes >= PACK_CACHE_FLUSH_BYTES) pack_cache_flush(pack);
+}
+
+uint8_t *gfx_texture_pack_read(const char *path, int *width, int *height) {
+    fs_file_t *f = fs_open(path);
+    if (!f) return NULL;
+    int64_t src_size = fs_size(f);
+    int64_t src_mtime = fs_mtime(f);
+
+    const char *name = NULL;
+    struct PackCache *pack = NULL;
+    uint8_t *pixels = NULL;
+    if (configTexturePackCache && src_size > 0) {
+        pthread_mutex_lock(&pack_cache_mutex);
+        pack = pack_cache_for(path, &name);
+        if (pack) pixels = pack_cache_find(pack, name, src_size, src_mtime, width, height);
+        pthread_mutex_unlock(&pack_cache_mutex);
+    }
+    if (pixels) {
+        fs_close(f);
+        return pixels;
+    }
+
+    uint8_t *imgdata = src_size > 0 ? malloc(src_size) : NULL;
+    if (imgdata && fs_read(f, imgdata, src_size) == src_size) {
+        pixels = pngutils_read_png_from_memory(imgdata, src_size, width, height, NULL, 4);
+    }
+    free(imgdata);
+    fs_close(f);
+
+    if (pixels && pack) {
+        pthread_mutex_lock(&pack_cache_mutex);
+        pack_cache_add(pack, name, src_size, src_mtime, pixels, *width, *height);
+        pthread_mutex_unlock(&pack_cache_mutex);
+    }
+    return pixels;
+}
+
+void gfx_texture_pack_cache_flush(void) {
+    pthread_mutex_lock(&pack_cache_mutex);
+    for (int i = 0; i < pack_cache_count; i++) pack_cache_flush(&pack_caches[i]);
+    pthread_mutex_unlock(&pack_cache_mutex);
+}
+
+#endif // EXTERNAL_DATA
@@ -0,0 +1,14 @@
+#ifndef GFX_TEXTURE_PACK_CACHE_H
+#define GFX_TEXTURE_PACK_CACHE_H
+
+#include <stdint.h>
+
+// Reads the texture at path as RGBA32, from its pack's decoded texture cache
+// when it's there and the PNG hasn't changed since, decoding it otherwise.
+// Returns NULL if it can't be read, otherwise the pixels are freed with pngutils_free.
+uint8_t *gfx_texture_pack_read(const char *path, int *width, int *height);
+
+// Writes textures decoded since the last flush to their packs' cache files
+void gfx_texture_pack_cache_flush(void);
+
+#endif
@@ -0,0 +1,137 @@
+#ifdef EXTERNAL_DATA
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "macros.h"
+#include "../platform.h"
+#include "../fs/fs.h"
+#include "pc/pngutils.h"
+#include "saturn/imgui/saturn_imgui.h"
+#include "gfx_texture_stream.h"
+#include "gfx_texture_pack_cache.h"
+
+// Texture streaming
+// Reading and decoding a texture pack's PNGs takes long enough to stall the
+// frame they first show up in, so gfx_pc hands them to worker threads, one
+// for each core, and uploads the pixels once they're decoded. Finished
+// textures are handed back in the order they finish.
+
+#define TEXTURE_STREAM_MIN_THREADS 2
+#define TEXTURE_STREAM_MAX_THREADS 16
+
+struct TextureStreamJob {
+    struct TextureStreamJob *next;
+    void *owner;
+    uint32_t serial;
+    char path[SYS_MAX_PATH];
+    char name[SYS_MAX_PATH];
+    uint8_t *pixels;
+    int width, height;
+};
+
+// guarded by stream_mutex
+static struct TextureStreamJob *stream_queue, **stream_queue_tail = &stream_queue;
+static struct TextureStreamJob *stream_done, **stream_done_tail = &stream_done;
+static int stream_pending; // queued or being decoded
+
+static pthread_mutex_t stream_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stream_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t stream_done_cond = PTHREAD_COND_INITIALIZER;
+static bool stream_threads_started;
+
+static void stream_decode(struct TextureStreamJob *job) {
+    saturn_fallback_texture(job->path, job->name);
+    job->pixels = gfx_texture_pack_read(job->path, &job->width, &job->height);
+    if (!job->pixels) fprintf(stderr, "could not load texture: `%s`\n", job->path);
+}
+
+static void *stream_thread_main(UNUSED void *arg) {
+    pthread_mutex_lock(&stream_mutex);
+    while (true) {
+        while (!stream_queue) pthread_cond_wait(&stream_cond, &stream_mutex);
+        struct TextureStreamJob *job = stream_queue;
+        stream_queue = job->next;
+        if (!stream_queue) stream_queue_tail = &stream_queue;
+        pthread_mutex_unlock(&stream_mutex);
+
+        stream_decode(job);
+
+        pthread_mutex_lock(&stream_mutex);
+        job->next = NULL;
+        *stream_done_tail = job;
+        stream_done_tail = &job->next;
+        stream_pending--;
+        pthread_cond_broadcast(&stream_done_cond);
+    }
+    return NULL;
+}
+
+void gfx_texture_stream_request(void *owner, uint32_t serial, const char *path, const char *name) {
+    struct TextureStreamJob *job = calloc(1, sizeof(struct TextureStreamJob));
+    if (!job) sys_fatal("out of memory queueing texture `%s`", name);
+    job->owner = owner;
+    job->serial = serial;
+    snprintf(job->path, sizeof(job->path), "%s", path);
+    snprintf(job->name, sizeof(job->name), "%s", name);
+
+    if (!stream_threads_started) {
+        int threads = sys_cpu_count();
+        if (threads < TEXTURE_STREAM_MIN_THREADS) threads = TEXTURE_STREAM_MIN_THREADS;
+        if (threads > TEXTURE_STREAM_MAX_THREADS) threads = TEXTURE_STREAM_MAX_THREADS;
+        for (int i = 0; i < threads; i++) {
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, stream_thread_main, NULL) != 0) sys_fatal("could not start the texture streaming threads");
+            pthread_detach(thread);
+        }
+        stream_threads_started = true;
+    }
+
+    pthread_mutex_lock(&stream_mutex);
+    *stream_queue_tail = job;
+    stream_queue_tail = &job->next;
+    stream_pending++;
+    pthread_cond_signal(&stream_cond);
+    pthread_mutex_unlock(&stream_mutex);
+}
+
+bool gfx_texture_stream_poll(void **owner, uint32_t *serial, uint8_t **pixels, int *width, int *height) {
+    pthread_mutex_lock(&stream_mutex);
+    struct TextureStreamJob *job = stream_done;
+    if (job) {
+        stream_done = job->next;
+        if (!stream_done) stream_done_tail = &stream_done;
+    }
+    pthread_mutex_unlock(&stream_mutex);
+    if (!job) return false;
+
+    *owner = job->owner;
+    *serial = job->serial;
+    *pixels = job->pixels;
+    *width = job->width;
+    *height = job->height;
+    free(job);
+    return true;
+}
+
+void gfx_texture_stream_free(uint8_t *pixels) {
+    pngutils_free(pixels);
+}
+
+void gfx_texture_stream_wait(void) {
+    pthread_mutex_lock(&stream_mutex);
+    while (stream_pending > 0) pthread_cond_wait(&stream_done_cond, &stream_mutex);
+    pthread_mutex_unlock(&stream_mutex);
+}
+
+bool gfx_texture_stream_wait_any(void) {
+    pthread_mutex_lock(&stream_mutex);
+    while (!stream_done && stream_pending > 0) pthread_cond_wait(&stream_done_cond, &stream_mutex);
+    bool ready = stream_done != NULL;
+    pthread_mutex_unlock(&stream_mutex);
+    return ready;
+}
+
+#endif // EXTERNAL_DATA
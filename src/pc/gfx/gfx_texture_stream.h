@@ -0,0 +1,21 @@
+#ifndef GFX_TEXTURE_STREAM_H
+#define GFX_TEXTURE_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Queues the texture at path (or texture name, if there's nothing at path) to
+// be decoded on a worker thread. owner and serial come back with the pixels.
+void gfx_texture_stream_request(void *owner, uint32_t serial, const char *path, const char *name);
+
+// Takes a decoded texture, returning false if none are ready. pixels is NULL
+// if the texture couldn't be loaded, otherwise it's freed with gfx_texture_stream_free.
+bool gfx_texture_stream_poll(void **owner, uint32_t *serial, uint8_t **pixels, int *width, int *height);
+void gfx_texture_stream_free(uint8_t *pixels);
+
+// Blocks until every queued texture is decoded and ready to be polled
+void gfx_texture_stream_wait(void);
+// Blocks until a texture is ready to be polled, returning false if none are queued
+bool gfx_texture_stream_wait_any(void);
+
+#endif
@@ -110,6 +110,32 @@ static inline void patch_interpolations(void) {
     patch_interpolated_snow_particles();
 }
 
+static void produce_audio(bool capturing_audio) {
+    int samples_left = audio_api->buffered();
+    u32 num_audio_samples = samples_left < audio_api->get_desired_buffered() ? SAMPLES_HIGH : SAMPLES_LOW;
+    // unpaced frames would flood the audio device and recorded audio can't
+    // depend on it, so use a fixed sample pattern (32 kHz over 60 frames)
+    // and don't play anything
+    bool offline = saturn_imgui_is_rendering_offline() || capturing_audio;
+    if (offline) {
+        static int audio_cnt = 0;
+        num_audio_samples = audio_cnt++ % 3 == 2 ? SAMPLES_HIGH : SAMPLES_LOW;
+    }
+    //printf("Audio samples: %d %u\n", samples_left, num_audio_samples);
+    s16 audio_buffer[SAMPLES_HIGH * 2 * 2];
+    for (int i = 0; i < 2; i++) {
+        /*if (audio_cnt-- == 0) {
+            audio_cnt = 2;
+        }
+        u32 num_audio_samples = audio_cnt < 2 ? 528 : 544;*/
+        create_next_audio_buffer(audio_buffer + i * (num_audio_samples * 2), num_audio_samples);
+    }
+    //printf("Audio samples before submitting: %d\n", audio_api->buffered());
+
+    if (!offline) audio_api->play((u8 *)audio_buffer, 2 * num_audio_samples * 4);
+    if (capturing_audio) saturn_imgui_capture_audio(audio_buffer, 2 * num_audio_samples);
+}
+
 void produce_one_frame(void) {
     if (saturn_imgui_is_processing_frame()) {
         saturn_imgui_ui_only_frame(true);
@@ -122,10 +148,19 @@ void produce_one_frame(void) {
     }
     saturn_imgui_ui_only_frame(false);
 
+    // posters replay the last game frame, once per tile
+    if (saturn_imgui_is_rendering_poster()) {
+        gfx_start_frame();
+        send_display_list(gGfxSPTask);
+        gfx_end_frame();
+        return;
+    }
+
     gfx_start_frame();
 
     f32 master_mod;
-    if (saturn_imgui_is_capturing_video()) master_mod = 0.f;
+    bool capturing_audio = saturn_imgui_is_capturing_audio();
+    if (saturn_imgui_is_capturing_video() && !capturing_audio) master_mod = 0.f;
     else master_mod = (f32)configMasterVolume / 127.0f;
 
     set_sequence_player_volume(SEQ_PLAYER_LEVEL, (f32)configMusicVolume / 127.0f * master_mod);
@@ -135,20 +170,8 @@ void produce_one_frame(void) {
     game_loop_one_iteration();
     thread6_rumble_loop(NULL);
 
-    int samples_left = audio_api->buffered();
-    u32 num_audio_samples = samples_left < audio_api->get_desired_buffered() ? SAMPLES_HIGH : SAMPLES_LOW;
-    //printf("Audio samples: %d %u\n", samples_left, num_audio_samples);
-    s16 audio_buffer[SAMPLES_HIGH * 2 * 2];
-    for (int i = 0; i < 2; i++) {
-        /*if (audio_cnt-- == 0) {
-            audio_cnt = 2;
-        }
-        u32 num_audio_samples = audio_cnt < 2 ? 528 : 544;*/
-        create_next_audio_buffer(audio_buffer + i * (num_audio_samples * 2), num_audio_samples);
-    }
-    //printf("Audio samples before submitting: %d\n", audio_api->buffered());
-
-    audio_api->play((u8 *)audio_buffer, 2 * num_audio_samples * 4);
+    // motion blur sub-frames share their output frame's audio
+    if (!saturn_imgui_is_motion_blur_subframe()) produce_audio(capturing_audio);
 
     gfx_end_frame();
 
@@ -173,20 +196,25 @@ void game_deinit(void) {
 #ifdef DISCORDRPC
     discord_shutdown();
 #endif
-    configfile_save(configfile_name());
+    // headless renders don't touch the user's settings
+    if (!gCLIOpts.RenderProject[0]) configfile_save(configfile_name());
     controller_shutdown();
     audio_shutdown();
     gfx_shutdown();
     inited = false;
 }
 
-void game_exit(void) {
+void game_exit_status(int status) {
     game_deinit();
 #ifndef TARGET_WEB
-    exit(0);
+    exit(status);
 #endif
 }
 
+void game_exit(void) {
+    game_exit_status(0);
+}
+
 #ifdef TARGET_WEB
 static void em_main_loop(void) {
 }
@@ -221,6 +249,17 @@ static void on_anim_frame(double time) {
 }
 #endif
 
+#ifdef EXTERNAL_DATA
+static void precache_progress(int done, int total) {
+    static int last_percent = -1;
+    int percent = total ? done * 100 / total : 100;
+    if (percent / 10 == last_percent / 10) return;
+    last_percent = percent;
+    fprintf(stdout, "precaching textures: %d/%d\n", done, total);
+    fflush(stdout);
+}
+#endif
+
 void main_func(void) {
     const char *gamedir = gCLIOpts.GameDir[0] ? gCLIOpts.GameDir : FS_BASEDIR;
     const char *userpath = gCLIOpts.SavePath[0] ? gCLIOpts.SavePath : sys_user_path();
@@ -292,7 +331,7 @@ void main_func(void) {
     if (configPrecacheRes) {
         fprintf(stdout, "precaching data\n");
         fflush(stdout);
-        gfx_precache_textures();
+        gfx_precache_textures_with_progress(false, precache_progress);
     }
 #endif
 
@@ -316,7 +355,28 @@ void main_func(void) {
 int main(int argc, char *argv[]) {
     init_logger();
     init_crash_handler();
-    parse_cli_opts(argc, argv);
+    // the messages are printed while parsing
+    if (!parse_cli_opts(argc, argv)) return 1;
+
+    if (!gCLIOpts.RenderProject[0] && (gCLIOpts.RenderChunk != 0 || gCLIOpts.RenderChunkFrames != 0)) {
+        fprintf(stderr, "--chunk and --chunk-frames only apply to --render.\n");
+        return 1;
+    }
+    if (gCLIOpts.RenderProject[0]) {
+        if (!gCLIOpts.RenderOutput[0]) {
+            fprintf(stderr, "--render needs an output file, set one with --out.\n");
+            return 1;
+        }
+        if (gCLIOpts.RenderFps != 0 && gCLIOpts.RenderFps != 30 && gCLIOpts.RenderFps != 60) {
+            fprintf(stderr, "--fps must be 30 or 60, not %u.\n", gCLIOpts.RenderFps);
+            return 1;
+        }
+        gCLIOpts.FullScreen = 2;
+#ifndef _WIN32
+        // without a display server, fall back to SDL's offscreen EGL driver
+        if (!getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY")) setenv("SDL_VIDEODRIVER", "offscreen", 0);
+#endif
+    }
 
     // Extract assets
     if (gCLIOpts.ExtractOnly) {
@@ -7,6 +7,7 @@ extern "C" {
 
 void game_deinit(void);
 void game_exit(void);
+void game_exit_status(int status);
 
 #ifdef __cplusplus
 }
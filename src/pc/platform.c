@@ -153,6 +153,11 @@ const char *sys_exe_path(void) {
     return path;
 }
 
+int sys_cpu_count(void) {
+    const int count = SDL_GetCPUCount();
+    return count > 0 ? count : 1;
+}
+
 static void sys_fatal_impl(const char *msg) {
     SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR , "Fatal error", msg, NULL);
     fprintf(stderr, "FATAL ERROR:\n%s\n", msg);
@@ -172,6 +177,10 @@ const char *sys_exe_path(void) {
     return ".";
 }
 
+int sys_cpu_count(void) {
+    return 1;
+}
+
 static void sys_fatal_impl(const char *msg) {
     fprintf(stderr, "FATAL ERROR:\n%s\n", msg);
     fflush(stderr);
@@ -23,6 +23,9 @@ const char *sys_exe_path(void);
 const char *sys_file_extension(const char *fpath);
 const char *sys_file_name(const char *fpath);
 
+// number of logical cores, at least 1
+int sys_cpu_count(void);
+
 // shows an error message in some way and terminates the game
 void sys_fatal(const char *fmt, ...) __attribute__ ((noreturn));
 
@@ -3,6 +3,259 @@
 #include <stb/stb_image.h>
 #include <stb/stb_image_write.h>
 
+static void pngutils_put32(unsigned char* o, unsigned int v) {
+    o[0] = v >> 24;
+    o[1] = v >> 16;
+    o[2] = v >> 8;
+    o[3] = v;
+}
+
+// Adds data to a running Adler-32. The sums are only reduced every 5552 bytes,
+// the most that can be added before s2 overflows 32 bits.
+static void pngutils_adler32(unsigned int* s1, unsigned int* s2, const unsigned char* data, size_t len) {
+    unsigned int a = *s1, b = *s2;
+    while (len > 0) {
+        size_t n = len < 5552 ? len : 5552;
+        len -= n;
+        while (n-- > 0) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    *s1 = a;
+    *s2 = b;
+}
+
+// Bytes pngutils_write_stored writes for raw_len bytes of scanlines
+static size_t pngutils_stored_size(size_t raw_len) {
+    size_t blocks = (raw_len + 65534) / 65535;
+    return raw_len + (blocks == 0 ? 1 : blocks) * 5;
+}
+
+// Writes count scanlines of row_bytes each as stored deflate blocks, with a
+// "none" filter byte in front of each, and adds them to the running Adler-32.
+// last marks the final block of the stream. Returns the end of the output.
+static unsigned char* pngutils_write_stored(unsigned char* o, const unsigned char* rows, size_t stride, size_t row_bytes, int count, int last, unsigned int* s1, unsigned int* s2) {
+    size_t line = row_bytes + 1;
+    size_t raw_len = line * count;
+    size_t pos = 0;
+    size_t row = 0, col = 0; // col 0 is the filter byte
+    do {
+        size_t len = raw_len - pos < 65535 ? raw_len - pos : 65535;
+        pos += len;
+        *o++ = last && pos == raw_len;
+        *o++ = len & 0xFF;
+        *o++ = len >> 8;
+        *o++ = ~len & 0xFF;
+        *o++ = (~len >> 8) & 0xFF;
+        unsigned char* data = o;
+        while (len > 0) {
+            size_t size;
+            if (col == 0) {
+                *o = 0;
+                size = 1;
+            }
+            else {
+                size = line - col;
+                if (size > len) size = len;
+                memcpy(o, rows + row * stride + col - 1, size);
+            }
+            col += size;
+            if (col == line) {
+                col = 0;
+                row++;
+            }
+            o += size;
+            len -= size;
+        }
+        pngutils_adler32(s1, s2, data, o - data);
+    } while (pos < raw_len);
+    return o;
+}
+
+// Unfiltered scanlines in uncompressed deflate blocks, for fast scratch renders
+static unsigned char* pngutils_write_png_stored(unsigned char* pixels, int stride_bytes, int x, int y, int n, int* out_len) {
+    int ctype[5] = { -1, 0, 4, 2, 6 };
+    unsigned char sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    if (stride_bytes == 0) stride_bytes = x * n;
+    size_t zlen = 2 + pngutils_stored_size(((size_t)x * n + 1) * y) + 4;
+    if (zlen > 0x7FFFFFFF - 57) return NULL;
+    unsigned char* out = (unsigned char*)STBIW_MALLOC(8 + 25 + 12 + zlen + 12);
+    if (!out) return NULL;
+    unsigned char* o = out;
+
+    memcpy(o, sig, 8); o += 8;
+    pngutils_put32(o, 13); o += 4;
+    memcpy(o, "IHDR", 4); o += 4;
+    pngutils_put32(o, x); o += 4;
+    pngutils_put32(o, y); o += 4;
+    *o++ = 8;
+    *o++ = ctype[n];
+    *o++ = 0;
+    *o++ = 0;
+    *o++ = 0;
+    pngutils_put32(o, stbiw__crc32(o - 17, 17)); o += 4;
+
+    pngutils_put32(o, (unsigned int)zlen); o += 4;
+    unsigned char* idat = o;
+    memcpy(o, "IDAT", 4); o += 4;
+    *o++ = 0x78;
+    *o++ = 0x01;
+    unsigned int s1 = 1, s2 = 0;
+    o = pngutils_write_stored(o, pixels, stride_bytes, (size_t)x * n, y, 1, &s1, &s2);
+    pngutils_put32(o, (s2 << 16) | s1); o += 4;
+    pngutils_put32(o, stbiw__crc32(idat, (int)(o - idat))); o += 4;
+
+    pngutils_put32(o, 0); o += 4;
+    memcpy(o, "IEND", 4); o += 4;
+    pngutils_put32(o, stbiw__crc32(o - 4, 4)); o += 4;
+
+    *out_len = (int)(o - out);
+    return out;
+}
+
+// Same as stb's writer, but with the deflate level passed in instead of read
+// from stbi_write_png_compression_level, so writers on other threads can use
+// their own
+static unsigned char* pngutils_write_png_deflated(unsigned char* pixels, int stride_bytes, int x, int y, int n, int* out_len, int level) {
+    int ctype[5] = { -1, 0, 4, 2, 6 };
+    unsigned char sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    if (stride_bytes == 0) stride_bytes = x * n;
+    unsigned char* filt = (unsigned char*)STBIW_MALLOC(((size_t)x * n + 1) * y);
+    signed char* line_buffer = (signed char*)STBIW_MALLOC((size_t)x * n);
+    if (!filt || !line_buffer) {
+        STBIW_FREE(filt);
+        STBIW_FREE(line_buffer);
+        return NULL;
+    }
+    for (int j = 0; j < y; j++) {
+        // pick the filter with the smallest sum of residuals, like stb does
+        int best_filter = 0, best_val = 0x7FFFFFFF;
+        for (int filter = 0; filter < 5; filter++) {
+            stbiw__encode_png_line(pixels, stride_bytes, x, y, j, n, filter, line_buffer);
+            int est = 0;
+            for (int i = 0; i < x * n; i++) est += abs(line_buffer[i]);
+            if (est < best_val) {
+                best_val = est;
+                best_filter = filter;
+            }
+        }
+        if (best_filter != 4) stbiw__encode_png_line(pixels, stride_bytes, x, y, j, n, best_filter, line_buffer);
+        filt[(size_t)j * (x * n + 1)] = (unsigned char)best_filter;
+        memcpy(filt + (size_t)j * (x * n + 1) + 1, line_buffer, (size_t)x * n);
+    }
+    STBIW_FREE(line_buffer);
+    int zlen;
+    unsigned char* zlib = stbi_zlib_compress(filt, y * (x * n + 1), &zlen, level);
+    STBIW_FREE(filt);
+    if (!zlib) return NULL;
+
+    unsigned char* out = (unsigned char*)STBIW_MALLOC(8 + 12 + 13 + 12 + zlen + 12);
+    if (!out) {
+        STBIW_FREE(zlib);
+        return NULL;
+    }
+    unsigned char* o = out;
+    memcpy(o, sig, 8); o += 8;
+    pngutils_put32(o, 13); o += 4;
+    memcpy(o, "IHDR", 4); o += 4;
+    pngutils_put32(o, x); o += 4;
+    pngutils_put32(o, y); o += 4;
+    *o++ = 8;
+    *o++ = ctype[n];
+    *o++ = 0;
+    *o++ = 0;
+    *o++ = 0;
+    pngutils_put32(o, stbiw__crc32(o - 17, 17)); o += 4;
+
+    pngutils_put32(o, zlen); o += 4;
+    memcpy(o, "IDAT", 4); o += 4;
+    memcpy(o, zlib, zlen); o += zlen;
+    STBIW_FREE(zlib);
+    pngutils_put32(o, stbiw__crc32(o - zlen - 4, zlen + 4)); o += 4;
+
+    pngutils_put32(o, 0); o += 4;
+    memcpy(o, "IEND", 4); o += 4;
+    pngutils_put32(o, stbiw__crc32(o - 4, 4)); o += 4;
+
+    *out_len = (int)(o - out);
+    return out;
+}
+
+// Streamed PNGs are written band by band as stored deflate blocks, one IDAT
+// chunk per band, for images too large to keep in memory
+
+struct PngStream {
+    FILE* file;
+    int x, y, n;
+    int rows_written;
+    unsigned int s1, s2;
+};
+
+static void pngutils_stream_chunk(struct PngStream* stream, unsigned char* chunk, int len) {
+    // chunk starts with the 4 byte type and has 4 spare bytes at the end for the crc
+    unsigned char size[4];
+    pngutils_put32(size, len - 4);
+    pngutils_put32(chunk + len, stbiw__crc32(chunk, len));
+    fwrite(size, 1, 4, stream->file);
+    fwrite(chunk, 1, len + 4, stream->file);
+}
+
+struct PngStream* pngutils_stream_begin(const char* filename, int x, int y, int comp) {
+    int ctype[5] = { -1, 0, 4, 2, 6 };
+    unsigned char sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    FILE* f = fopen(filename, "wb");
+    if (!f) return NULL;
+    struct PngStream* stream = (struct PngStream*)STBIW_MALLOC(sizeof(struct PngStream));
+    stream->file = f;
+    stream->x = x;
+    stream->y = y;
+    stream->n = comp;
+    stream->rows_written = 0;
+    stream->s1 = 1;
+    stream->s2 = 0;
+    fwrite(sig, 1, 8, f);
+    unsigned char ihdr[4 + 13 + 4] = { 'I', 'H', 'D', 'R' };
+    pngutils_put32(ihdr + 4, x);
+    pngutils_put32(ihdr + 8, y);
+    ihdr[12] = 8;
+    ihdr[13] = ctype[comp];
+    pngutils_stream_chunk(stream, ihdr, 17);
+    unsigned char zlib_header[4 + 2 + 4] = { 'I', 'D', 'A', 'T', 0x78, 0x01 };
+    pngutils_stream_chunk(stream, zlib_header, 6);
+    return stream;
+}
+
+int pngutils_stream_rows(struct PngStream* stream, const unsigned char* rows, int count) {
+    if (count > stream->y - stream->rows_written) count = stream->y - stream->rows_written;
+    if (count <= 0) return 0;
+    size_t row_bytes = (size_t)stream->x * stream->n;
+    unsigned char* chunk = (unsigned char*)STBIW_MALLOC(4 + pngutils_stored_size((row_bytes + 1) * count) + 4);
+    if (!chunk) return 0;
+    unsigned char* o = chunk;
+    memcpy(o, "IDAT", 4); o += 4;
+    int last = stream->rows_written + count == stream->y;
+    o = pngutils_write_stored(o, rows, row_bytes, row_bytes, count, last, &stream->s1, &stream->s2);
+    pngutils_stream_chunk(stream, chunk, (int)(o - chunk));
+    STBIW_FREE(chunk);
+    stream->rows_written += count;
+    return count;
+}
+
+int pngutils_stream_end(struct PngStream* stream) {
+    int complete = stream->rows_written == stream->y;
+    unsigned char adler[4 + 4 + 4] = { 'I', 'D', 'A', 'T' };
+    pngutils_put32(adler + 4, (stream->s2 << 16) | stream->s1);
+    pngutils_stream_chunk(stream, adler, 8);
+    unsigned char iend[4 + 4] = { 'I', 'E', 'N', 'D' };
+    pngutils_stream_chunk(stream, iend, 4);
+    fclose(stream->file);
+    STBIW_FREE(stream);
+    return complete;
+}
+
 unsigned char* pngutils_write_png_to_mem(unsigned char* pixels, int stride_bytes, int x, int y, int n, int* out_len) {
     return stbi_write_png_to_mem(pixels, stride_bytes, x, y, n, out_len);
 }
@@ -11,6 +264,19 @@ int pngutils_write_png(const char* filename, int x, int y, int comp, const void*
     return stbi_write_png(filename, x, y, comp, data, stride_bytes);
 }
 
+int pngutils_write_png_level(const char* filename, int x, int y, int comp, const void* data, int stride_bytes, int level) {
+    int len;
+    unsigned char* png = level > 0
+        ? pngutils_write_png_deflated((unsigned char*)data, stride_bytes, x, y, comp, &len, level)
+        : pngutils_write_png_stored((unsigned char*)data, stride_bytes, x, y, comp, &len);
+    if (!png) return 0;
+    FILE* f = fopen(filename, "wb");
+    int ok = f != NULL && fwrite(png, 1, len, f) == (size_t)len;
+    if (f && fclose(f) != 0) ok = 0;
+    STBIW_FREE(png);
+    return ok;
+}
+
 unsigned char* pngutils_read_png_from_memory(const unsigned char* data, int len, int* x, int* y, int* depth, int desired_channels) {
     return stbi_load_from_memory(data, len, x, y, depth, desired_channels);
 }
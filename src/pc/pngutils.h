@@ -6,6 +6,13 @@
 
 extern unsigned char* pngutils_write_png_to_mem(unsigned char* pixels, int stride_bytes, int x, int y, int n, int* out_len);
 extern int pngutils_write_png(const char* filename, int x, int y, int comp, const void* data, int stride_bytes);
+// level 0 writes stored deflate blocks, for fast scratch renders, 1-9 are zlib levels
+extern int pngutils_write_png_level(const char* filename, int x, int y, int comp, const void* data, int stride_bytes, int level);
+
+struct PngStream;
+extern struct PngStream* pngutils_stream_begin(const char* filename, int x, int y, int comp);
+extern int pngutils_stream_rows(struct PngStream* stream, const unsigned char* rows, int count);
+extern int pngutils_stream_end(struct PngStream* stream);
 extern unsigned char* pngutils_read_png_from_memory(const unsigned char* data, int len, int* x, int* y, int* depth, int desired_channels);
 extern unsigned char* pngutils_read_png(const char* filename, int* x, int* y, int* comp, int req_comp);
 extern void pngutils_free(void* data);
@@ -84,6 +84,7 @@
 
 extern "C" {
 #include "pc/gfx/gfx_pc.h"
+#include "pc/gfx/gfx_opengl.h"
 #include "pc/configfile.h"
 #include "game/mario.h"
 #include "game/game_init.h"
@@ -92,6 +93,8 @@ extern "C" {
 #include "engine/level_script.h"
 #include "game/object_list_processor.h"
 #include "pc/pngutils.h"
+#include "pc/cliopts.h"
+#include "pc/pc_main.h"
 #include "game/object_helpers.h"
 }
 
@@ -485,38 +488,444 @@ bool saturn_imgui_get_viewport(int* width, int* height) {
 void* framebuffer;
 pthread_t capture_thread;
 int renderer_current_frame, renderer_num_frames = 0;
+int renderer_first_frame = 0;
+int renderer_total_frames, renderer_chunk_frames;
+int renderer_chunk = -1, renderer_num_chunks = 0;
+bool saturn_capture_start_next();
 bool ui_only_frame = false;
+bool audio_capturing = false;
+
+// Video frames are read back into a ring of pixel buffer objects and only
+// mapped a few frames later, so the GPU never has to wait on the CPU
+
+#define CAPTURE_PBO_RING_MAX 8
+
+struct CapturePBO {
+    GLuint buffer;
+    GLsync fence;
+};
+
+CapturePBO capture_pbos[CAPTURE_PBO_RING_MAX];
+int capture_pbo_count = 0;
+int capture_pbo_head = 0;
+int capture_pbo_pending = 0;
+uint64_t capture_pbo_size = 0;
+
+void saturn_capture_pbo_init() {
+    capture_pbo_count = configCapturePboRing > CAPTURE_PBO_RING_MAX ? CAPTURE_PBO_RING_MAX : configCapturePboRing;
+    capture_pbo_head = 0;
+    capture_pbo_pending = 0;
+    capture_pbo_size = (uint64_t)videores[0] * (uint64_t)videores[1] * 4;
+    for (int i = 0; i < capture_pbo_count; i++) {
+        glGenBuffers(1, &capture_pbos[i].buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, capture_pbos[i].buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, capture_pbo_size, NULL, GL_STREAM_READ);
+        capture_pbos[i].fence = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void saturn_capture_pbo_free() {
+    for (int i = 0; i < capture_pbo_count; i++) {
+        if (capture_pbos[i].fence) glDeleteSync(capture_pbos[i].fence);
+        glDeleteBuffers(1, &capture_pbos[i].buffer);
+    }
+    capture_pbo_count = 0;
+    capture_pbo_pending = 0;
+}
+
+void saturn_capture_pbo_queue(GLuint texture) {
+    CapturePBO* pbo = &capture_pbos[(capture_pbo_head + capture_pbo_pending) % capture_pbo_count];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo->buffer);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    pbo->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    capture_pbo_pending++;
+}
+
+// Copies the oldest queued frame into the encoder queue, returns false if
+// it isn't ready yet and block is false. A frame that can't be read back
+// fails the render, later frames are dropped instead of leaving a gap.
+bool saturn_capture_pbo_pop(bool block) {
+    if (capture_pbo_pending == 0) return false;
+    CapturePBO* pbo = &capture_pbos[capture_pbo_head];
+    GLenum status = glClientWaitSync(pbo->fence, GL_SYNC_FLUSH_COMMANDS_BIT, block ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(pbo->fence);
+    pbo->fence = 0;
+    capture_pbo_head = (capture_pbo_head + 1) % capture_pbo_count;
+    capture_pbo_pending--;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo->buffer);
+    void* data = status == GL_WAIT_FAILED ? nullptr : glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, capture_pbo_size, GL_MAP_READ_BIT);
+    if (!data) {
+        std::cout << "Failed reading back a video frame" << std::endl;
+        video_renderer_failed = true;
+        stop_capture = 1;
+    }
+    else {
+        if (!video_renderer_failed) {
+            unsigned char* image = video_renderer_queue_acquire();
+            memcpy(image, data, capture_pbo_size);
+            video_renderer_queue_submit();
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void saturn_capture_advance_frame() {
+    renderer_current_frame++;
+    k_current_frame = renderer_current_frame / (sixty_fps_enabled ? 2 : 1);
+    if (renderer_current_frame < renderer_first_frame) k_current_frame = renderer_first_frame / (sixty_fps_enabled ? 2 : 1);
+    if (k_current_frame != k_previous_frame) for (auto& timeline : k_frame_keys) {
+        saturn_keyframe_apply(timeline.first, k_current_frame);
+    }
+    k_previous_frame = k_current_frame;
+}
+
+// Motion blur renders every output frame as several sub-frames with the
+// keyframes stepped fractionally between them, summed on the GPU. The world
+// only ticks on the first one, the rest just move keyframed values.
+
+int motion_blur_samples = 1;
+int motion_blur_subframe = 0;
+
+// returns the texture to capture, or 0 if this sub-frame only accumulates
+GLuint saturn_capture_motion_blur(GLuint texture) {
+    gfx_opengl_accumulate(texture, motion_blur_subframe == 0, 1.f / motion_blur_samples);
+    if (++motion_blur_subframe < motion_blur_samples) {
+        float frame = (renderer_current_frame + motion_blur_subframe / (float)motion_blur_samples) / (sixty_fps_enabled ? 2 : 1);
+        for (auto& timeline : k_frame_keys) {
+            saturn_keyframe_apply(timeline.first, frame);
+        }
+        return 0;
+    }
+    motion_blur_subframe = 0;
+    k_previous_frame = -1; // make the next frame apply its keyframes again
+    return gfx_opengl_resolve_accumulation();
+}
 
 void* saturn_capture_screenshot(void* image) {
     processing_frame = true;
-    if (renderer_num_frames != 0) {
-        if (renderer_current_frame >= 0) video_renderer_render((unsigned char*)image);
-        renderer_current_frame++;
-        k_current_frame = renderer_current_frame / (sixty_fps_enabled ? 2 : 1);
-        if (renderer_current_frame < 0) k_current_frame = 0;
-        if (k_current_frame != k_previous_frame) for (auto& timeline : k_frame_keys) {
-            saturn_keyframe_apply(timeline.first, k_current_frame);
+    capturing_video = false;
+    pngutils_write_png(capture_destination_file.c_str(), (int)videores[0], (int)videores[1], 4, image, 0);
+    free(image);
+    processing_frame = false;
+    return NULL;
+}
+
+void saturn_capture_video_frame(GLuint texture) {
+    if (motion_blur_samples > 1 && renderer_current_frame >= renderer_first_frame && !stop_capture) {
+        texture = saturn_capture_motion_blur(texture);
+        if (texture == 0) return;
+    }
+
+    // Warmup frames are never written, so don't read them back either
+    if (renderer_current_frame >= renderer_first_frame) {
+        if (capture_pbo_count != 0) saturn_capture_pbo_queue(texture);
+        else {
+            unsigned char* image = video_renderer_queue_acquire();
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            video_renderer_queue_submit();
         }
-        k_previous_frame = k_current_frame;
-        if (stop_capture || renderer_current_frame == renderer_num_frames) {
-            capturing_video = false;
-            stop_capture = false;
-            video_renderer_finalize();
+    }
+    saturn_capture_advance_frame();
+
+    if (!stop_capture && renderer_current_frame != renderer_num_frames) {
+        saturn_capture_pbo_pop(capture_pbo_pending == capture_pbo_count);
+        return;
+    }
+
+    // Drain the ring in order before closing the output
+    while (saturn_capture_pbo_pop(true));
+    saturn_capture_pbo_free();
+    video_renderer_queue_stop();
+    bool cancelled = stop_capture;
+    capturing_video = false;
+    stop_capture = false;
+    video_renderer_finalize();
+    if (audio_capturing) video_renderer_audio_end();
+    audio_capturing = false;
+
+    if (cancelled) video_renderer_failed = true;
+    if (cancelled || renderer_chunk < 0) return;
+    video_chunk_finish(renderer_chunk);
+    saturn_capture_start_next();
+}
+
+// Poster renders
+// The last game frame is replayed once per tile and sample with the projection
+// narrowed to that tile and jittered by a subpixel offset. Samples are summed
+// one row of tiles at a time and streamed out as PNG rows, so neither VRAM nor
+// RAM ever holds the whole image.
+
+int poster_tiles = 4;
+int poster_samples = 2; // per axis
+bool poster_rendering = false;
+int poster_tile, poster_sample;
+std::vector<uint16_t> poster_band = {};
+struct PngStream* poster_png = nullptr;
+
+void saturn_poster_set_projection() {
+    int tx = poster_tile % poster_tiles, ty = poster_tile / poster_tiles;
+    float jx = ((poster_sample % poster_samples) + 0.5f) / poster_samples - 0.5f;
+    float jy = ((poster_sample / poster_samples) + 0.5f) / poster_samples - 0.5f;
+    gfx_set_projection_tile(
+        poster_tiles, poster_tiles,
+        poster_tiles - 1 - 2 * tx + jx * 2 / videores[0],
+        1 - poster_tiles + 2 * ty + jy * 2 / videores[1]
+    );
+}
+
+bool saturn_imgui_render_poster(std::string destination) {
+    poster_png = pngutils_stream_begin(destination.c_str(), videores[0] * poster_tiles, videores[1] * poster_tiles, 4);
+    if (!poster_png) return false;
+    transparency_enabled = checkbox_transparency_enabled;
+    capturing_video = true;
+    keyframe_playing = false;
+    renderer_num_frames = 0;
+    poster_rendering = true;
+    poster_tile = 0;
+    poster_sample = 0;
+    poster_band.assign((size_t)videores[0] * poster_tiles * videores[1] * 4, 0);
+    saturn_poster_set_projection();
+    return true;
+}
+
+bool saturn_imgui_is_rendering_poster() {
+    return poster_rendering;
+}
+
+void saturn_poster_capture(GLuint texture) {
+    int w = videores[0], h = videores[1];
+    int tx = poster_tile % poster_tiles;
+    std::vector<unsigned char> image = std::vector<unsigned char>((size_t)w * h * 4);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    for (int y = 0; y < h; y++) {
+        uint16_t* dst = poster_band.data() + ((size_t)y * w * poster_tiles + (size_t)tx * w) * 4;
+        unsigned char* src = image.data() + (size_t)y * w * 4;
+        for (int x = 0; x < w * 4; x++) {
+            dst[x] += src[x];
+        }
+    }
+
+    int samples = poster_samples * poster_samples;
+    if (++poster_sample < samples) {
+        saturn_poster_set_projection();
+        return;
+    }
+    poster_sample = 0;
+    poster_tile++;
+    if (poster_tile % poster_tiles == 0) {
+        // a row of tiles is done, resolve and stream it out
+        std::vector<unsigned char> rows = std::vector<unsigned char>(poster_band.size());
+        for (size_t i = 0; i < rows.size(); i++) {
+            rows[i] = (poster_band[i] + samples / 2) / samples;
         }
+        pngutils_stream_rows(poster_png, rows.data(), h);
+        std::fill(poster_band.begin(), poster_band.end(), 0);
+    }
+    if (poster_tile < poster_tiles * poster_tiles) {
+        saturn_poster_set_projection();
+        return;
+    }
+    pngutils_stream_end(poster_png);
+    poster_png = nullptr;
+    poster_band.clear();
+    poster_band.shrink_to_fit();
+    gfx_set_projection_tile(1, 1, 0, 0);
+    poster_rendering = false;
+    capturing_video = false;
+}
+
+// Starts the next chunk that isn't listed as done yet, or the whole timeline
+// if the render isn't chunked. Returns false once there's nothing left.
+bool saturn_capture_start_next() {
+    if (renderer_num_chunks == 0) {
+        renderer_first_frame = 0;
+        renderer_num_frames = renderer_total_frames;
     }
     else {
-        capturing_video = false;
-        pngutils_write_png(capture_destination_file.c_str(), (int)videores[0], (int)videores[1], 4, image, 0);
+        int chunk = renderer_chunk + 1;
+        // --chunk only renders one chunk, another process renders the rest
+        if (gCLIOpts.RenderChunk != 0) chunk = renderer_chunk < 0 ? gCLIOpts.RenderChunk - 1 : renderer_num_chunks;
+        while (chunk < renderer_num_chunks && video_chunk_is_done(chunk)) {
+            if (gCLIOpts.RenderChunk != 0) chunk = renderer_num_chunks;
+            else chunk++;
+        }
+        if (chunk >= renderer_num_chunks) {
+            // whichever process finishes the last chunk joins them
+            renderer_chunk = -1;
+            renderer_num_frames = 0;
+            video_chunks_concat();
+            return false;
+        }
+        renderer_chunk = chunk;
+        renderer_first_frame = chunk * renderer_chunk_frames;
+        renderer_num_frames = renderer_first_frame + renderer_chunk_frames;
+        if (renderer_num_frames > renderer_total_frames) renderer_num_frames = renderer_total_frames;
+        saturn_set_video_destination(video_chunk_path(chunk));
+    }
+    capturing_video = true;
+    renderer_current_frame = renderer_first_frame - 3;
+    k_previous_frame = -1;
+    video_first_frame = renderer_first_frame;
+    motion_blur_samples = configMotionBlurSamples < 1 ? 1 : configMotionBlurSamples;
+    motion_blur_subframe = 0;
+    video_renderer_init(videores[0], videores[1], sixty_fps_enabled);
+    video_renderer_queue_start(videores[0], videores[1], configCaptureQueueDepth);
+    saturn_capture_pbo_init();
+    audio_capturing = configCaptureAudio;
+    if (audio_capturing) video_renderer_audio_begin(renderer_chunk);
+    return true;
+}
+
+bool saturn_imgui_render_video(std::string destination) {
+    if (!saturn_set_video_destination(destination)) return false;
+    video_renderer_failed = false;
+    transparency_enabled = checkbox_transparency_enabled;
+    sixty_fps_enabled = checkbox_sixty_fps_enabled;
+    if (!(video_renderer_flags & VIDEO_RENDERER_FLAGS_60FPS)) sixty_fps_enabled = false;
+    if (!(video_renderer_flags & VIDEO_RENDERER_FLAGS_TRANSPARECY)) transparency_enabled = false;
+    keyframe_playing = false;
+    renderer_total_frames = saturn_keyframe_get_length() * (sixty_fps_enabled ? 2 : 1);
+    renderer_chunk_frames = gCLIOpts.RenderChunkFrames != 0 ? gCLIOpts.RenderChunkFrames : configRenderChunkFrames;
+    renderer_chunk = -1;
+    renderer_num_chunks = 0;
+    if (renderer_chunk_frames != 0 && (video_renderer_flags & VIDEO_RENDERER_FLAGS_CHUNKS)) {
+        // chunks are only joined if they were all rendered the same way
+        int blur = configMotionBlurSamples < 1 ? 1 : configMotionBlurSamples;
+        std::string settings =
+            std::to_string((int)videores[0]) + "x" + std::to_string((int)videores[1]) +
+            " " + (sixty_fps_enabled ? "60" : "30") + "fps" +
+            " " + std::filesystem::path(destination).extension().string().substr(1) +
+            " blur" + std::to_string(blur) +
+            (transparency_enabled ? " transparent" : " opaque");
+        renderer_num_chunks = video_chunks_begin(destination, renderer_total_frames, renderer_chunk_frames, settings);
+    }
+    // --chunk has to pick a chunk that's left to render
+    if (gCLIOpts.RenderChunk != 0) {
+        int chunk = gCLIOpts.RenderChunk;
+        if (renderer_num_chunks == 0) {
+            std::cout << "--chunk " << chunk << " needs a chunked render, set --chunk-frames for a format that supports it" << std::endl;
+            return false;
+        }
+        if (chunk > renderer_num_chunks) {
+            std::cout << "--chunk " << chunk << " is past the last chunk, there are " << renderer_num_chunks << std::endl;
+            return false;
+        }
+        if (video_chunk_is_done(chunk - 1)) {
+            std::cout << "Chunk " << chunk << " of " << destination << " is already rendered" << std::endl;
+            return false;
+        }
+    }
+    saturn_capture_start_next();
+    return true;
+}
+
+// Headless renders started with --render: load the project, wait for it to
+// finish warping, render the timeline, then quit
+
+int cli_render_state = 0;
+
+void saturn_cli_render_update() {
+    if (!gCLIOpts.RenderProject[0]) return;
+    switch (cli_render_state) {
+        case 0: {
+            // saturn_load_project looks in dynos/projects, so paths to files
+            // elsewhere are made relative to it
+            std::filesystem::path project = gCLIOpts.RenderProject;
+            if (!std::filesystem::exists(project)) project = std::filesystem::path("dynos/projects") / project;
+            if (!std::filesystem::exists(project)) {
+                std::cout << "Project " << gCLIOpts.RenderProject << " not found" << std::endl;
+                game_exit_status(1);
+            }
+            std::string name = std::filesystem::relative(project, "dynos/projects").string();
+            saturn_load_project((char*)name.c_str());
+            cli_render_state++;
+            break;
+        }
+        case 1:
+            if (current_project != "") break;
+            if (k_frame_keys.empty()) {
+                std::cout << "Project has no keyframes to render" << std::endl;
+                game_exit_status(1);
+            }
+            if (gCLIOpts.RenderWidth != 0) {
+                videores[0] = gCLIOpts.RenderWidth;
+                videores[1] = gCLIOpts.RenderHeight;
+            }
+            if (!saturn_set_video_destination(gCLIOpts.RenderOutput)) {
+                std::cout << "Unsupported output format " << gCLIOpts.RenderOutput << std::endl;
+                game_exit_status(1);
+            }
+            // --fps is checked to be 30 or 60 before startup
+            if (gCLIOpts.RenderFps == 60 && !(video_renderer_flags & VIDEO_RENDERER_FLAGS_60FPS)) {
+                std::cout << "The format of " << gCLIOpts.RenderOutput << " can't be rendered at 60 fps" << std::endl;
+                game_exit_status(1);
+            }
+            checkbox_sixty_fps_enabled = gCLIOpts.RenderFps == 60;
+            if (!saturn_imgui_render_video(gCLIOpts.RenderOutput)) game_exit_status(1);
+            std::cout << "Rendering " << renderer_total_frames << " frames to " << gCLIOpts.RenderOutput << std::endl;
+            cli_render_state++;
+            break;
+        case 2:
+            if (capturing_video) break;
+            if (video_renderer_failed) {
+                std::cout << "Failed rendering " << gCLIOpts.RenderOutput << std::endl;
+                game_exit_status(1);
+            }
+            std::cout << "Finished rendering " << gCLIOpts.RenderOutput << std::endl;
+            game_exit();
+            break;
     }
-    free(image);
-    processing_frame = false;
-    return NULL;
 }
 
 bool saturn_imgui_is_capturing_video() {
     return capturing_video;
 }
 
+bool saturn_imgui_is_capturing_audio() {
+    return capturing_video && audio_capturing;
+}
+
+// Called with the audio of one game tick, before that tick's frames are
+// captured. It's split evenly between those frames so warmup frames don't
+// end up in the track.
+void saturn_imgui_capture_audio(short* samples, int count) {
+    if (!saturn_imgui_is_capturing_audio()) return;
+    int frames = sixty_fps_enabled ? 2 : 1;
+    for (int i = 0; i < frames; i++) {
+        int frame = renderer_current_frame + i;
+        if (frame < renderer_first_frame || frame >= renderer_num_frames) continue;
+        int begin = count * i / frames;
+        int end = count * (i + 1) / frames;
+        video_renderer_audio_write(samples + begin * 2, end - begin);
+    }
+}
+
+// Whether the game iteration about to run only renders a motion blur sub-frame.
+// At 60 fps every iteration is captured twice, so the world ticks once per 2K captures.
+bool saturn_imgui_is_motion_blur_subframe() {
+    if (!capturing_video || renderer_num_frames == 0 || stop_capture) return false;
+    if (motion_blur_samples <= 1 || renderer_current_frame < renderer_first_frame) return false;
+    if (!sixty_fps_enabled) return motion_blur_subframe != 0;
+    int capture = renderer_current_frame * motion_blur_samples + motion_blur_subframe;
+    return (capture + 1) % (2 * motion_blur_samples) >= 2;
+}
+
+// Video renders don't depend on wall time, so they can run unpaced
+bool saturn_imgui_is_rendering_offline() {
+    return capturing_video && renderer_num_frames != 0 && (configOfflineRender || gCLIOpts.RenderProject[0]);
+}
+
 bool saturn_imgui_is_orthographic() {
     return orthographic_mode;
 }
@@ -545,7 +954,15 @@ bool saturn_imgui_is_capturing_transparent_video() {
 
 void saturn_imgui_set_frame_buffer(void* fb, bool do_capture) {
     framebuffer = fb;
+    if (poster_rendering) {
+        saturn_poster_capture((GLuint)(intptr_t)fb);
+        return;
+    }
     if (!processing_frame && !ui_only_frame && capturing_video && (do_capture || sixty_fps_enabled)) {
+        if (renderer_num_frames != 0) {
+            saturn_capture_video_frame((GLuint)(intptr_t)fb);
+            return;
+        }
         uint64_t tex_size = (uint64_t)videores[0] * (uint64_t)videores[1] * 4;
         unsigned char* image = (unsigned char*)malloc(tex_size);
         glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)fb);
@@ -1114,6 +1531,8 @@ int num_objects_as_actors = 0;
 void saturn_imgui_update() {
     if (!splash_finished) return;
 
+    saturn_cli_render_update();
+
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplSDL2_NewFrame(window);
     ImGui::NewFrame();
@@ -1469,6 +1888,17 @@ void saturn_imgui_update() {
             imgui_bundled_tooltip("Unsupported for MP4s");
             ImGui::Checkbox("60 FPS", &checkbox_sixty_fps_enabled);
             imgui_bundled_tooltip("Unsupported for GIFs");
+            ImGui::SliderInt("PNG Compression", (int*)&configPngCompression, 0, 9, "%d", ImGuiSliderFlags_AlwaysClamp);
+            imgui_bundled_tooltip("0 writes uncompressed PNGs, which is the fastest for scratch renders");
+            ImGui::Checkbox("Offline Rendering", &configOfflineRender);
+            imgui_bundled_tooltip("Renders videos as fast as possible instead of in real time");
+            ImGui::SliderInt("Motion Blur", (int*)&configMotionBlurSamples, 1, 16, "%d samples", ImGuiSliderFlags_AlwaysClamp);
+            imgui_bundled_tooltip("Renders each frame this many times between keyframes and blends them");
+            int chunk_frames = configRenderChunkFrames;
+            if (ImGui::InputInt("Chunk Length", &chunk_frames)) configRenderChunkFrames = chunk_frames < 0 ? 0 : chunk_frames;
+            imgui_bundled_tooltip("Renders videos in pieces of this many frames, so a cancelled render can pick up where it left off. 0 renders in one go.");
+            ImGui::Checkbox("Record Audio", &configCaptureAudio);
+            imgui_bundled_tooltip("Saved as a .wav next to PNG sequences and GIFs");
             int curr_projection = request_ortho_mode == 0 ? orthographic_mode : request_ortho_mode - 1;
             if (ImGui::Combo("Projection", &curr_projection,
                 "Perspective\0"
@@ -1513,20 +1943,18 @@ void saturn_imgui_update() {
             ImGui::BeginDisabled(k_frame_keys.empty());
             if (ImGui::Button("Render Video")) {
                 capture_destination_file = save_file_dialog("Save Video", video_formats);
-                if (!capture_destination_file.empty()) {
-                    saturn_set_video_destination(capture_destination_file);
-                    transparency_enabled = checkbox_transparency_enabled;
-                    sixty_fps_enabled = checkbox_sixty_fps_enabled;
-                    if (!(video_renderer_flags & VIDEO_RENDERER_FLAGS_60FPS)) sixty_fps_enabled = false;
-                    if (!(video_renderer_flags & VIDEO_RENDERER_FLAGS_TRANSPARECY)) transparency_enabled = false;
-                    capturing_video = true;
-                    keyframe_playing = false;
-                    renderer_current_frame = -3;
-                    renderer_num_frames = saturn_keyframe_get_length() * (sixty_fps_enabled ? 2 : 1);
-                    video_renderer_init(videores[0], videores[1], sixty_fps_enabled);
-                }
+                if (!capture_destination_file.empty()) saturn_imgui_render_video(capture_destination_file);
             }
             ImGui::EndDisabled();
+            ImGui::SliderInt("Poster Tiles", &poster_tiles, 1, 16, "%dx", ImGuiSliderFlags_AlwaysClamp);
+            ImGui::SliderInt("Poster Supersampling", &poster_samples, 1, 8, "%dx", ImGuiSliderFlags_AlwaysClamp);
+            imgui_bundled_tooltip("Renders each tile this many times per axis with a subpixel offset");
+            if (ImGui::Button("Render Poster (.png)")) {
+                capture_destination_file = save_file_dialog("Save Poster", { "PNG image", "*.png" });
+                if (!capture_destination_file.empty()) saturn_imgui_render_poster(capture_destination_file);
+            }
+            ImGui::SameLine();
+            ImGui::TextDisabled("%dx%d", videores[0] * poster_tiles, videores[1] * poster_tiles);
         }
         ImGui::End();
     }
@@ -1833,15 +2261,28 @@ void saturn_imgui_update() {
             ImVec2(1.0f, 1.0f)
         );
         ImGui::End();
+        if (poster_rendering) {
+            int tiles = poster_tiles * poster_tiles;
+            ImGui::SetNextWindowPos(ImVec2(8, menu_bar_size.y + 8), ImGuiCond_Always);
+            ImGui::SetNextWindowSizeConstraints(ImVec2(250, 0), ImVec2(FLT_MAX, FLT_MAX));
+            ImGui::Begin("Rendering...", nullptr, base_flags);
+            ImGui::ProgressBar(poster_tile / (float)tiles);
+            ImGui::Text("Tile %d/%d", poster_tile + 1, tiles);
+            ImGui::End();
+        }
         if (renderer_num_frames > 0) {
-            int curr_frame = renderer_current_frame < 0 ? 0 : renderer_current_frame;
+            int curr_frame = renderer_current_frame < renderer_first_frame ? renderer_first_frame : renderer_current_frame;
             ImGui::SetNextWindowPos(ImVec2(8, menu_bar_size.y + 8), ImGuiCond_Always);
             ImGui::SetNextWindowSizeConstraints(ImVec2(250, 0), ImVec2(FLT_MAX, FLT_MAX));
             ImGui::Begin("Rendering...", nullptr, base_flags);
-            ImGui::ProgressBar(curr_frame / (float)renderer_num_frames);
+            ImGui::ProgressBar((curr_frame - renderer_first_frame) / (float)(renderer_num_frames - renderer_first_frame));
             if (ImGui::Button("Cancel")) saturn_imgui_stop_capture();
             ImGui::SameLine();
             ImGui::Text("%d/%d", curr_frame, renderer_num_frames);
+            if (renderer_chunk >= 0) ImGui::Text("Chunk %d/%d", renderer_chunk + 1, renderer_num_chunks);
+            VideoRendererQueueStats stats = video_renderer_queue_get_stats();
+            ImGui::Text("Encoder queue: %d/%d", stats.depth, stats.capacity);
+            ImGui::Text("Stalled: %.2fs", stats.stall_time);
             ImGui::End();
         }   
     }
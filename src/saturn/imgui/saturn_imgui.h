@@ -84,6 +84,11 @@ extern "C" {
 #endif
     bool saturn_imgui_is_capturing_transparent_video();
     bool saturn_imgui_is_capturing_video();
+    bool saturn_imgui_is_capturing_audio();
+    void saturn_imgui_capture_audio(short* samples, int count);
+    bool saturn_imgui_is_motion_blur_subframe();
+    bool saturn_imgui_is_rendering_poster();
+    bool saturn_imgui_is_rendering_offline();
     bool saturn_imgui_is_orthographic();
     bool saturn_imgui_is_processing_frame();
     void saturn_imgui_ui_only_frame(bool is_ui_only);
@@ -173,6 +173,7 @@ void ssettings_imgui_update() {
             configEditorTextures = 0;
             current_texture_id = -1;
             texture_forwards.clear();
+            saturn_texture_rules_invalidate();
             gfx_precache_textures();
         }
         for (int i = 0; i < textures_list.size(); i++) {
@@ -189,6 +190,7 @@ void ssettings_imgui_update() {
                         texture_forwards.insert({ entry.first, entry.second.asString() });
                     }
                 }
+                saturn_texture_rules_invalidate();
                 gfx_precache_textures();
                 split_skyboxes();
             }
@@ -200,6 +202,11 @@ void ssettings_imgui_update() {
         gfx_precache_textures();
         split_skyboxes();
     }
+    ImGui::SameLine();
+    if (ImGui::Button("Precache Level")) {
+        gfx_precache_textures_with_progress(true, NULL);
+    }
+    imgui_bundled_tooltip("Loads the textures the current level and DynOS packs use right away; Avoids hitches the first time they show up.");
     ImGui::PopItemWidth();
 #ifdef DISCORDRPC
     ImGui::Checkbox(ICON_FK_DISCORD " Discord Activity Status", &configDiscordRPC);
@@ -259,6 +266,36 @@ void ssettings_imgui_update() {
         ImGui::Checkbox("Anti-aliasing", &configWindow.enable_antialias);
         imgui_bundled_tooltip("Enable smooth edges via OpenGL.");
 
+        ImGui::Checkbox("Batch opaque geometry", &configBatchOpaque);
+        imgui_bundled_tooltip("Groups solid polys by shader and texture before drawing them; Faster in busy scenes.");
+
+        ImGui::Checkbox("Threaded display lists", &configThreadedGfx);
+        imgui_bundled_tooltip("Reads the scene on a second thread while the main one draws it; Helps on slow CPUs.");
+
+        ImGui::Checkbox("Shared combiner shader", &configUberShader);
+        imgui_bundled_tooltip("Picks color combiners in one shader instead of compiling one for each; Fewer program switches, but more work per pixel. Requires restart.");
+        int shader_loads, program_binds;
+        gfx_opengl_get_shader_stats(&shader_loads, &program_binds);
+        ImGui::TextDisabled("%d shader changes, %d program binds last frame", shader_loads, program_binds);
+
+        ImGui::Checkbox("Frustum culling", &configFrustumCulling);
+        imgui_bundled_tooltip("Skips models that are entirely off-screen; Disable if something pops out near the edges.");
+
+        ImGui::Checkbox("Stream textures", &configTextureStreaming);
+        imgui_bundled_tooltip("Loads texture pack images in the background, showing them once they're ready; Video capture always waits for them.");
+        ImGui::Checkbox("Cache decoded textures", &configTexturePackCache);
+        imgui_bundled_tooltip("Keeps texture pack images decoded in the save folder so they load faster next time; Changed images are decoded again.");
+
+        ImGui::PushItemWidth(150);
+        ImGui::SliderInt("Texture memory###texture_cache_budget", (int*)&configTextureCacheBudget, 0, 4096, configTextureCacheBudget == 0 ? "No limit" : "%d MB");
+        ImGui::PopItemWidth();
+        imgui_bundled_tooltip("How much video memory cached textures may take before the least recently used ones are dropped; Raise it for large texture packs.");
+        GfxTextureCacheStats texture_cache_stats;
+        gfx_get_texture_cache_stats(&texture_cache_stats);
+        ImGui::TextDisabled("%u textures, %llu MB; %llu hits, %llu misses, %llu evicted", texture_cache_stats.entries,
+            (unsigned long long)(texture_cache_stats.bytes_used >> 20), (unsigned long long)texture_cache_stats.hits,
+            (unsigned long long)texture_cache_stats.misses, (unsigned long long)texture_cache_stats.evictions);
+
         ImGui::Dummy(ImVec2(0, 5));
 
         ImGui::Checkbox("Stretched widescreen", &configWindow.jabo_mode);
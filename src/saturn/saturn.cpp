@@ -38,6 +38,7 @@ extern "C" {
 #include "engine/surface_collision.h"
 #include "game/object_collision.h"
 #include "game/object_list_processor.h"
+#include "pc/cliopts.h"
 }
 
 bool mario_exists;
@@ -782,7 +783,7 @@ void saturn_update() {
         marioScaleSizeZ = marioScaleSizeX;
     }
 
-    if (is_spinning && mario_exists) {
+    if (is_spinning && mario_exists && !saturn_imgui_is_motion_blur_subframe()) {
         gMarioState->faceAngle[1] += (s16)(spin_mult * 15 * 182.04f);
     }
 
@@ -809,7 +810,8 @@ void* saturn_keyframe_get_timeline_ptr(KeyframeTimeline& timeline) {
     // cast to char since its 1 byte long
 }
 
-float saturn_keyframe_setup_interpolation(std::string id, int frame, int* keyframe, bool* last) {
+// frame can be fractional, for motion blur sub-frames
+float saturn_keyframe_setup_interpolation(std::string id, float frame, int* keyframe, bool* last) {
     KeyframeTimeline timeline = k_frame_keys[id].first;
     std::vector<Keyframe> keyframes = k_frame_keys[id].second;
 
@@ -835,7 +837,7 @@ float saturn_keyframe_setup_interpolation(std::string id, int frame, int* keyfra
 }
 
 // applies the values from keyframes to its destination, returns true if its the last frame, false if otherwise
-bool saturn_keyframe_apply(std::string id, int frame) {
+bool saturn_keyframe_apply(std::string id, float frame) {
     if (!saturn_timeline_exists(id.c_str())) return true;
 
     KeyframeTimeline timeline = k_frame_keys[id].first;
@@ -1339,7 +1341,7 @@ bool saturn_splash_screen_update(SDL_Renderer* renderer) {
 int saturn_splash_screen_open() {
     // make the x11 compositor on linux not kill itself
     SDL_SetHint(SDL_HINT_VIDEO_X11_NET_WM_BYPASS_COMPOSITOR, "0");
-    SDL_Window* window = SDL_CreateWindow("Saturn Studio", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 640, 360, 0);
+    SDL_Window* window = SDL_CreateWindow("Saturn Studio", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 640, 360, gCLIOpts.RenderProject[0] ? SDL_WINDOW_HIDDEN : 0);
     SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
     SDL_SetWindowBordered(window, SDL_FALSE);
@@ -232,19 +232,24 @@ void bhv_mario_actor_loop() {
 ColorCode default_cc;
 bool inited_default_cc = false;
 
-void override_cc_color(int* r, int* g, int* b, int ccIndex, int marioIndex, int shadeIndex, float intensity, bool additive) {
+// the color code of the current object, or null if it doesn't have one
+struct ColorTemplate* saturn_actor_get_colorcode(int marioIndex) {
     if (!inited_default_cc) {
         inited_default_cc = true;
         PasteGameShark(DEFAULT_COLOR_CODE, default_cc);
     }
-    ColorCode cc;
     MarioActor* actor = saturn_get_actor(marioIndex);
     if (o->behavior != bhvMarioActor) actor = nullptr;
     if (actor == nullptr) {
-        if (o->behavior == bhvMario) memcpy(cc, default_cc, sizeof(ColorCode));
-        else return; 
+        if (o->behavior == bhvMario) return default_cc;
+        return nullptr;
     }
-    else memcpy(cc, actor->colorcode, sizeof(ColorCode));
+    return actor->colorcode;
+}
+
+void override_cc_color(int* r, int* g, int* b, int ccIndex, int marioIndex, int shadeIndex, float intensity, bool additive) {
+    struct ColorTemplate* cc = saturn_actor_get_colorcode(marioIndex);
+    if (cc == nullptr) return;
     *r = (*r * additive) + intensity * cc[ccIndex].red[shadeIndex];
     *g = (*g * additive) + intensity * cc[ccIndex].green[shadeIndex];
     *b = (*b * additive) + intensity * cc[ccIndex].blue[shadeIndex];
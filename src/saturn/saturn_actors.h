@@ -92,6 +92,7 @@ extern "C" {
     void saturn_clear_actors();
     void bhv_mario_actor_loop();
     void override_cc_color(int* r, int* g, int* b, int ccIndex, int marioIndex, int shadeIndex, float intensity, bool additive);
+    struct ColorTemplate* saturn_actor_get_colorcode(int marioIndex);
     void saturn_rotate_head(Vec3s rotation);
     void saturn_rotate_torso(Vec3s rotation);
     s16 saturn_actor_geo_switch(u8 item);
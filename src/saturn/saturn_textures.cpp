@@ -1,6 +1,9 @@
 #include "saturn/saturn_textures.h"
 
 #include <string>
+#include <string_view>
+#include <cstring>
+#include <unordered_map>
 #include <iostream>
 #include <vector>
 #include <algorithm>
@@ -24,6 +27,7 @@ extern "C" {
 #include "game/mario.h"
 #include "game/camera.h"
 #include "game/level_update.h"
+#include "game/game_init.h"
 #include "game/object_list_processor.h"
 #include "sm64.h"
 #include "pc/gfx/gfx_pc.h"
@@ -123,6 +127,7 @@ std::vector<Expression> LoadExpressions(Model* model, std::string modelFolderPat
     if (model->UsingVanillaEyes())
         expressions_list.insert(expressions_list.begin(), VanillaEyes);
 
+    saturn_texture_rules_invalidate();
     return expressions_list;
 }
 
@@ -137,6 +142,7 @@ void LoadEyesFolder(Model* model) {
     }
     if (model->Expressions.size() == 0) model->Expressions.push_back(VanillaEyes);
     else if (model->UsingVanillaEyes()) model->Expressions[0] = VanillaEyes;
+    saturn_texture_rules_invalidate();
 }
 
 std::map<std::string, std::string*> heap_strs = {};
@@ -145,168 +151,221 @@ std::string* stack_to_heap(std::string str) {
     return heap_strs[str];
 }
 
+/*
+    Texture rewrite rules, one per texture name pointer handed to saturn_bind_texture.
+    Everything that only depends on the name (what kind of texture it is, its
+    forwarded and skybox-swapped names) is worked out the first time it's bound,
+    so a bind is one hash lookup plus whatever the current settings ask for.
+    Rules are dropped when the texture pack or any model's expressions reload.
+*/
+
+enum {
+    TEXTURE_RULE_SKYBOX        = 1 << 0,
+    TEXTURE_RULE_CLOUD         = 1 << 1,
+    TEXTURE_RULE_CHROMA_OBJECT = 1 << 2,
+    TEXTURE_RULE_CHROMA_LEVEL  = 1 << 3,
+    TEXTURE_RULE_EXPRESSION    = 1 << 4,
+    TEXTURE_RULE_VANILLA_EYE   = 1 << 5,
+    TEXTURE_RULE_NO_EMBLEM     = 1 << 6,
+};
+
+#define CHROMA_SKYBOX_COUNT 10
+static const char* chroma_skyboxes[CHROMA_SKYBOX_COUNT] = {
+    "water", "bitfs", "wdw", "cloud_floor", "ccm", "ssl", "bbh", "bidw", "clouds", "bits"
+};
+
+// cached result of an expression texture, valid while its source stays the same
+struct TextureRuleOutput {
+    const TexturePath* source = nullptr;
+    std::string source_path;
+    const char* output = nullptr;
+};
+
+struct TextureRule {
+    std::string name; // names can share a hash, and freed names their pointer
+    const char* forwarded;
+    int flags = 0;
+    const char* skyboxes[CHROMA_SKYBOX_COUNT] = {};
+    const char* cloud_floor = nullptr;
+    // which expression of a model this texture belongs to
+    const std::vector<Expression>* expressions = nullptr;
+    const Expression* expressions_data = nullptr;
+    int expression_match = -1;
+    TextureRuleOutput expression_output;
+    TextureRuleOutput eye_output;
+};
+
+// keyed by a hash of the whole name
+static std::unordered_map<size_t, TextureRule> texture_rules;
+static u32 painting_visibility_timer = -1;
+static int painting_visibility_state = -1;
+
+void saturn_texture_rules_invalidate() {
+    texture_rules.clear();
+}
+
+static TextureRule& saturn_texture_rule(const void* input) {
+    std::string_view name = (const char*)input;
+    size_t hash = std::hash<std::string_view>()(name);
+    auto it = texture_rules.find(hash);
+    if (it != texture_rules.end() && it->second.name == name) return it->second;
+
+    TextureRule& rule = texture_rules[hash];
+    rule = TextureRule();
+    rule.name = name;
+    rule.forwarded = saturn_texture_forward((const char*)input);
+    if (rule.forwarded == (const char*)0x7365727574786574) return rule;
+
+    std::string texName = rule.forwarded;
+    if (texName.find("textures/skyboxes/") != string::npos) rule.flags |= TEXTURE_RULE_SKYBOX;
+    if (texName.find("textures/skyboxes/cloud.") != string::npos) rule.flags |= TEXTURE_RULE_CLOUD;
+    if (texName.find("castle_grounds_textures.0BC00.ia16") != string::npos ||
+        texName.find("butterfly_wing.rgba16") != string::npos)
+            rule.flags |= TEXTURE_RULE_CHROMA_OBJECT;
+    if (texName.find("saturn") == string::npos &&
+        texName.find("dynos") == string::npos &&
+        texName.find("mario_") == string::npos &&
+        texName.find("mario/") == string::npos &&
+        texName.find("skybox") == string::npos &&
+        texName.find("shadow_quarter_circle.ia8") == string::npos &&
+        texName.find("shadow_quarter_square.ia8") == string::npos &&
+        (texName.find("segment2.11C58.rgba16") != string::npos ||
+         texName.find("segment2.12C58.rgba16") != string::npos ||
+         texName.find("segment2.13C58.rgba16") != string::npos))
+            rule.flags |= TEXTURE_RULE_CHROMA_LEVEL;
+    if (texName.find("saturn_") != string::npos) rule.flags |= TEXTURE_RULE_EXPRESSION;
+    if (texName.find("saturn_eye") != string::npos ||
+        // Unused vanilla textures
+        texName == "actors/mario/mario_eyes_left_unused.rgba16.png" ||
+        texName == "actors/mario/mario_eyes_right_unused.rgba16.png" ||
+        texName == "actors/mario/mario_eyes_up_unused.rgba16.png" ||
+        texName == "actors/mario/mario_eyes_down_unused.rgba16.png")
+            rule.flags |= TEXTURE_RULE_VANILLA_EYE;
+    if (texName == "actors/mario/no_m.rgba16.png") rule.flags |= TEXTURE_RULE_NO_EMBLEM;
+    return rule;
+}
+
+static const char* saturn_texture_rule_skybox(TextureRule& rule, int background) {
+    if (rule.skyboxes[background] == nullptr) {
+        std::string texName = rule.forwarded;
+        std::string skybox_key = texName.substr(18, texName.find_first_of(".") - 18);
+        rule.skyboxes[background] = stack_to_heap(texName.replace(18, skybox_key.length(), chroma_skyboxes[background]))->c_str();
+    }
+    return rule.skyboxes[background];
+}
+
+static const char* saturn_texture_rule_output(TextureRuleOutput& cached, TexturePath& texture) {
+    if (cached.source != &texture || cached.source_path != texture.FilePath) {
+        cached.source = &texture;
+        cached.source_path = texture.FilePath;
+        cached.output = stack_to_heap(texture.GetRelativePath())->c_str();
+    }
+    return cached.output;
+}
+
+// Painting visibility, once per game tick or when the chroma settings change
+static void saturn_update_painting_visibility() {
+    int state = autoChroma | (autoChromaObjects << 1);
+    if (painting_visibility_timer == gGlobalTimer && painting_visibility_state == state) return;
+    painting_visibility_timer = gGlobalTimer;
+    painting_visibility_state = state;
+
+    struct Painting* paintings[] = {
+        &bob_painting, &ccm_painting, &wf_painting, &jrb_painting, &lll_painting, &ssl_painting, &hmc_painting,
+        &ddd_painting, &wdw_painting, &thi_tiny_painting, &ttm_painting, &ttc_painting, &sl_painting, &thi_huge_painting,
+    };
+    for (struct Painting* painting : paintings) {
+        painting->alpha = (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
+        if (autoChroma && !autoChromaObjects) painting->state = 1;
+    }
+}
+
 /*
     Handles texture replacement. Called from gfx_pc.c
 */
 const void* saturn_bind_texture(const void* input) {
     if (input == nullptr) return input;
-    input = saturn_texture_forward((const char*)input);
-    const char* inputTexture = static_cast<const char*>(input);
-    const char* outputTexture;
+    TextureRule& rule = saturn_texture_rule(input);
+    input = rule.forwarded;
 
     if (input == (const void*)0x7365727574786574) return input;
-    
-    std::string texName = inputTexture;
 
     // AUTO-CHROMA
 
     // Overwrite skybox
     // This runs for both Auto-chroma and the Chroma Key Stage
     if (autoChroma || gCurrLevelNum == LEVEL_SA) {
-        if (use_color_background) {
+        if (rule.flags & TEXTURE_RULE_SKYBOX) {
             // Use white, recolorable textures for our color background
-            if (texName.find("textures/skyboxes/") != string::npos)
+            if (use_color_background)
                 return "textures/saturn/white.rgba16.png";
-        } else {
             // Swapping skyboxes IDs
-            if (texName.find("textures/skyboxes/") != string::npos) {
-                std::string skybox_key = texName.substr(18, texName.find_first_of(".") - 18);
-                switch(gChromaKeyBackground) {
-                    case 0: return static_cast<const void*>(stack_to_heap(texName.replace(18, skybox_key.length(), "water"))->c_str());
-                    case 1: return static_cast<const void*>(stack_to_heap(texName.replace(18, skybox_key.length(), "bitfs"))->c_str());
-                    case 2: return static_cast<const void*>(stack_to_heap(texName.replace(18, skybox_key.length(), "wdw"))->c_str());
-                    case 3: return static_cast<const void*>(stack_to_heap(texName.replace(18, skybox_key.length(), "cloud_floor"))->c_str());
-                    case 4: return static_cast<const void*>(stack_to_heap(texName.replace(18, skybox_key.length(), "ccm"))->c_str());
-                    case 5: return static_cast<const void*>(stack_to_heap(texName.replace(18, skybox_key.length(), "ssl"))->c_str());
-                    case 6: return static_cast<const void*>(stack_to_heap(texName.replace(18, skybox_key.length(), "bbh"))->c_str());
-                    case 7: return static_cast<const void*>(stack_to_heap(texName.replace(18, skybox_key.length(), "bidw"))->c_str());
-                    case 8: return static_cast<const void*>(stack_to_heap(texName.replace(18, skybox_key.length(), "clouds"))->c_str());
-                    case 9: return static_cast<const void*>(stack_to_heap(texName.replace(18, skybox_key.length(), "bits"))->c_str());
-                }
-            }
+            if (gChromaKeyBackground < CHROMA_SKYBOX_COUNT)
+                return saturn_texture_rule_skybox(rule, gChromaKeyBackground);
         }
 
         if (autoChroma) {
             // Toggle object visibility
-            if (!autoChromaObjects) {
-                if (texName.find("castle_grounds_textures.0BC00.ia16") != string::npos ||
-                    texName.find("butterfly_wing.rgba16") != string::npos) {
-                        return "textures/saturn/mario_logo.rgba16.png";
-                }
-            }
+            if (!autoChromaObjects && (rule.flags & TEXTURE_RULE_CHROMA_OBJECT))
+                return "textures/saturn/mario_logo.rgba16.png";
             // Toggle level visibility
-            if (!autoChromaLevel) {
-                if (texName.find("saturn") == string::npos &&
-                    texName.find("dynos") == string::npos &&
-                    texName.find("mario_") == string::npos &&
-                    texName.find("mario/") == string::npos &&
-                    texName.find("skybox") == string::npos &&
-                    texName.find("shadow_quarter_circle.ia8") == string::npos &&
-                    texName.find("shadow_quarter_square.ia8") == string::npos) {
-
-                        if (texName.find("segment2.11C58.rgba16") != string::npos ||
-                            texName.find("segment2.12C58.rgba16") != string::npos ||
-                            texName.find("segment2.13C58.rgba16") != string::npos) {
-                                return "textures/saturn/mario_logo.rgba16.png";
-                        }
-
-                }
-            }
+            if (!autoChromaLevel && (rule.flags & TEXTURE_RULE_CHROMA_LEVEL))
+                return "textures/saturn/mario_logo.rgba16.png";
         }
 
-        // Painting visibility
-        bob_painting.alpha =        (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        ccm_painting.alpha =        (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        wf_painting.alpha =         (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        jrb_painting.alpha =        (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        lll_painting.alpha =        (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        ssl_painting.alpha =        (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        hmc_painting.alpha =        (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        ddd_painting.alpha =        (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        wdw_painting.alpha =        (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        thi_tiny_painting.alpha =   (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        ttm_painting.alpha =        (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        ttc_painting.alpha =        (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        sl_painting.alpha =         (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-        thi_huge_painting.alpha =   (autoChroma & !autoChromaObjects) ? 0x00 : 0xFF;
-
-        if (autoChroma && !autoChromaObjects)  bob_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  ccm_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  wf_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  jrb_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  lll_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  ssl_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  hmc_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  ddd_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  wdw_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  thi_tiny_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  ttm_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  ttc_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  sl_painting.state = 1;
-        if (autoChroma && !autoChromaObjects)  thi_huge_painting.state = 1;
+        saturn_update_painting_visibility();
     }
 
-    if (texName.find("textures/skyboxes/cloud.") != string::npos)
-        return static_cast<const void*>(stack_to_heap(texName.replace(18, 5, "cloud_floor"))->c_str());
+    if (rule.flags & TEXTURE_RULE_CLOUD) {
+        if (rule.cloud_floor == nullptr) rule.cloud_floor = stack_to_heap(std::string(rule.forwarded).replace(18, 5, "cloud_floor"))->c_str();
+        return rule.cloud_floor;
+    }
+
+    if (!(rule.flags & (TEXTURE_RULE_EXPRESSION | TEXTURE_RULE_VANILLA_EYE | TEXTURE_RULE_NO_EMBLEM))) return input;
 
     MarioActor* actor = saturn_get_actor(gCurrentObject->oMarioActorIndex);
     if (actor == nullptr) return input;
+    std::vector<Expression>& expressions = actor->model.Expressions;
 
     // Custom model expressions
-    if (actor->model.Active && texName.find("saturn_") != std::string::npos) {
-        for (int i = 0; i < actor->model.Expressions.size(); i++) {
-            Expression expression = actor->model.Expressions[i];
-            if (expression.CurrentIndex < 0) return input;
-            // Checks if the incoming texture has the expression's "key"
+    if (actor->model.Active && (rule.flags & TEXTURE_RULE_EXPRESSION)) {
+        if (rule.expressions != &expressions || rule.expressions_data != expressions.data()) {
+            // Checks which expression's "key" the texture has
             // This could be "saturn_eye", "saturn_mouth", etc.
-            if (expression.PathHasReplaceKey(texName, "saturn_")) {
-                outputTexture = stack_to_heap(expression.Textures[expression.CurrentIndex].GetRelativePath())->c_str();
-                const void* output = static_cast<const void*>(outputTexture);
-                return output;
+            std::string texName = rule.forwarded;
+            rule.expressions = &expressions;
+            rule.expressions_data = expressions.data();
+            rule.expression_match = -1;
+            for (int i = 0; i < expressions.size(); i++) {
+                if (expressions[i].PathHasReplaceKey(texName, "saturn_")) {
+                    rule.expression_match = i;
+                    break;
+                }
             }
         }
+        int count = rule.expression_match < 0 ? expressions.size() : rule.expression_match + 1;
+        for (int i = 0; i < count; i++) {
+            if (expressions[i].CurrentIndex < 0) return input;
+        }
+        if (rule.expression_match >= 0) {
+            Expression& expression = expressions[rule.expression_match];
+            return saturn_texture_rule_output(rule.expression_output, expression.Textures[expression.CurrentIndex]);
+        }
     }
 
     // Vanilla eye textures
-    if (actor->model.Expressions.size() > 0) {
-        if (actor->custom_eyes && actor->model.UsingVanillaEyes() && actor->model.Expressions[0].Name == "eyes") {
-            if (texName.find("saturn_eye") != string::npos ||
-                // Unused vanilla textures
-                texName == "actors/mario/mario_eyes_left_unused.rgba16.png" ||
-                texName == "actors/mario/mario_eyes_right_unused.rgba16.png" ||
-                texName == "actors/mario/mario_eyes_up_unused.rgba16.png" ||
-                texName == "actors/mario/mario_eyes_down_unused.rgba16.png") {
-                    if (actor->model.Expressions[0].Textures.size() > 0) {
-                        outputTexture = stack_to_heap(actor->model.Expressions[0].Textures[actor->model.Expressions[0].CurrentIndex].GetRelativePath())->c_str();
-                        const void* output = static_cast<const void*>(outputTexture);
-                        return output;
-                    }
+    if (expressions.size() > 0 && (rule.flags & TEXTURE_RULE_VANILLA_EYE)) {
+        if (actor->custom_eyes && actor->model.UsingVanillaEyes() && expressions[0].Name == "eyes") {
+            if (expressions[0].Textures.size() > 0) {
+                return saturn_texture_rule_output(rule.eye_output, expressions[0].Textures[expressions[0].CurrentIndex]);
             }
         }
     }
 
-    // Non-model custom blink cycle
-    /*if (force_blink && eye_array.size() > 0 && is_replacing_eyes) {
-        if (texName == "actors/mario/mario_eyes_center.rgba16.png" && blink_eye_1 != "") {
-            outputTexture = blink_eye_1.c_str();
-            const void* output = static_cast<const void*>(outputTexture);
-            return output;
-        } else if (texName == "actors/mario/mario_eyes_half_closed.rgba16.png" && blink_eye_2 != "") {
-            outputTexture = blink_eye_2.c_str();
-            const void* output = static_cast<const void*>(outputTexture);
-            return output;
-        } else if (texName == "actors/mario/mario_eyes_closed.rgba16.png" && blink_eye_3 != "") {
-            outputTexture = blink_eye_3.c_str();
-            const void* output = static_cast<const void*>(outputTexture);
-            return output;
-        }
-    }*/
-
     // Non-model cap logo/emblem
 
-    if (actor->show_emblem) {
-        if (texName == "actors/mario/no_m.rgba16.png")
-            return "actors/mario/mario_logo.rgba16.png";
+    if (actor->show_emblem && (rule.flags & TEXTURE_RULE_NO_EMBLEM)) {
+        return "actors/mario/mario_logo.rgba16.png";
     }
 
     return input;
@@ -68,6 +68,8 @@ std::size_t number_of_files_in_directory(std::filesystem::path path);
 
 extern bool show_vmario_emblem;
 
+void saturn_texture_rules_invalidate();
+
 extern "C" {
 #endif
     const void* saturn_bind_texture(const void*);
@@ -1,19 +1,39 @@
 #include "saturn_video_renderer.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <cstdio>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <io.h>
+#include <process.h>
+#include <windows.h>
+#else
+#include <signal.h>
+#include <unistd.h>
+#endif
+
 extern "C" {
 #include "pc/pngutils.h"
 }
 
-void pngseq_finalize() {}
-
 int video_width;
 int video_height;
 int png_counter;
@@ -22,88 +42,318 @@ std::string output;
 
 FILE* ffmpeg;
 
+// PNG sequences are compressed by a pool of workers, the file name is
+// picked when the frame is queued so numbering doesn't depend on which
+// worker finishes first
+
+struct PngJob {
+    int index;
+    int compression;
+    unsigned char* data;
+};
+
+std::vector<std::thread> png_workers = {};
+std::deque<PngJob> png_jobs = {};
+std::mutex png_mutex;
+std::condition_variable png_cv;
+bool png_workers_running = false;
+size_t png_max_jobs;
+
+void pngseq_write(PngJob job) {
+    std::string file = output.substr(0, output.find_last_of("."));
+    if (!pngutils_write_png_level((file + std::to_string(job.index) + ".png").c_str(), video_width, video_height, 4, job.data, 0, job.compression)) video_renderer_failed = true;
+    free(job.data);
+}
+
+void pngseq_work() {
+    while (true) {
+        PngJob job;
+        {
+            std::unique_lock<std::mutex> lock(png_mutex);
+            png_cv.wait(lock, []() { return !png_jobs.empty() || !png_workers_running; });
+            if (png_jobs.empty()) break;
+            job = png_jobs.front();
+            png_jobs.pop_front();
+        }
+        png_cv.notify_all();
+        pngseq_write(job);
+    }
+}
+
 void pngseq_init(int w, int h, bool fps60) {
     video_width = w;
     video_height = h;
-    png_counter = 0;
+    png_counter = video_first_frame;
+    int threads = std::thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+    png_max_jobs = (size_t)threads * 2;
+    png_workers_running = true;
+    for (int i = 0; i < threads; i++) {
+        png_workers.push_back(std::thread(pngseq_work));
+    }
 }
 
 void pngseq_render(unsigned char* data) {
-    std::string file = output.substr(0, output.find_last_of("."));
-    pngutils_write_png((file + std::to_string(++png_counter) + ".png").c_str(), video_width, video_height, 4, data, 0);
+    // the caller reuses its buffer, so the workers get their own copy
+    size_t size = (size_t)video_width * video_height * 4;
+    PngJob job = { ++png_counter, video_png_compression, (unsigned char*)malloc(size) };
+    memcpy(job.data, data, size);
+    std::unique_lock<std::mutex> lock(png_mutex);
+    png_cv.wait(lock, []() { return png_jobs.size() < png_max_jobs; });
+    png_jobs.push_back(job);
+    lock.unlock();
+    png_cv.notify_all();
 }
 
-void webm_init(int w, int h, bool fps60) {
-    video_width = w;
-    video_height = h;
-    std::string cmd = "ffmpeg -y -r " + std::string(fps60 ? "60" : "30") + " -f rawvideo -pix_fmt rgba -s " + std::to_string(w) + "x" + std::to_string(h) + " -i - -c:v libvpx-vp9 -pix_fmt yuva420p \"" + output + "\"";
+void pngseq_finalize() {
+    {
+        std::lock_guard<std::mutex> lock(png_mutex);
+        png_workers_running = false;
+    }
+    png_cv.notify_all();
+    for (std::thread& worker : png_workers) {
+        worker.join();
+    }
+    png_workers.clear();
+}
+
+// YUV conversion
+// ffmpeg would otherwise convert the RGBA frames on a single thread on its
+// side of the pipe. Converting here splits the work across cores, and a
+// 4:2:0 frame is less than half the size of an RGBA one (5/8 with alpha).
+// The conversion of a frame overlaps with the pipe write of the previous one.
+// The band workers and the writer are started once per video and woken for
+// each frame.
+
+std::vector<unsigned char> yuv_buffers[2];
+int yuv_current;
+bool yuv_alpha;
+std::vector<std::thread> yuv_workers = {};
+std::thread yuv_writer;
+std::mutex yuv_mutex;
+std::condition_variable yuv_cv; // wakes the workers and the writer
+std::condition_variable yuv_done_cv; // wakes the caller
+bool yuv_running = false;
+int yuv_band;
+int yuv_generation; // bumped for each frame handed to the workers
+int yuv_bands_left;
+unsigned char* yuv_rgba;
+unsigned char* yuv_target;
+std::vector<unsigned char>* yuv_pending; // buffer the writer still has to send
+
+// BT.601 limited range, same as ffmpeg's default rgba -> yuv420p scaler
+void ffmpeg_yuv_convert_rows(unsigned char* rgba, unsigned char* yuv, int y0, int y1) {
+    int w = video_width, h = video_height;
+    int cw = (w + 1) / 2, ch = (h + 1) / 2;
+    unsigned char* plane_y = yuv;
+    unsigned char* plane_u = plane_y + (size_t)w * h;
+    unsigned char* plane_v = plane_u + (size_t)cw * ch;
+    unsigned char* plane_a = plane_v + (size_t)cw * ch;
+    for (int y = y0; y < y1; y++) {
+        unsigned char* src = rgba + (size_t)y * w * 4;
+        unsigned char* dst = plane_y + (size_t)y * w;
+        for (int x = 0; x < w; x++) {
+            int r = src[x * 4 + 0], g = src[x * 4 + 1], b = src[x * 4 + 2];
+            dst[x] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        }
+        if (yuv_alpha) {
+            unsigned char* dst_a = plane_a + (size_t)y * w;
+            for (int x = 0; x < w; x++) {
+                dst_a[x] = src[x * 4 + 3];
+            }
+        }
+    }
+    for (int y = y0 / 2; y < (y1 + 1) / 2; y++) {
+        unsigned char* row0 = rgba + (size_t)(y * 2) * w * 4;
+        unsigned char* row1 = y * 2 + 1 < h ? row0 + (size_t)w * 4 : row0;
+        unsigned char* dst_u = plane_u + (size_t)y * cw;
+        unsigned char* dst_v = plane_v + (size_t)y * cw;
+        for (int x = 0; x < cw; x++) {
+            int x0 = x * 8, x1 = x * 2 + 1 < w ? x0 + 4 : x0;
+            int r = (row0[x0 + 0] + row0[x1 + 0] + row1[x0 + 0] + row1[x1 + 0] + 2) >> 2;
+            int g = (row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1] + 2) >> 2;
+            int b = (row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2] + 2) >> 2;
+            dst_u[x] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+            dst_v[x] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        }
+    }
+}
+
+// converts band index + 1, the caller does the first one
+void ffmpeg_yuv_work(int index) {
+    int generation = 0;
+    while (true) {
+        unsigned char* rgba;
+        unsigned char* yuv;
+        {
+            std::unique_lock<std::mutex> lock(yuv_mutex);
+            yuv_cv.wait(lock, [&]() { return yuv_generation != generation || !yuv_running; });
+            if (!yuv_running) break;
+            generation = yuv_generation;
+            rgba = yuv_rgba;
+            yuv = yuv_target;
+        }
+        int y = (index + 1) * yuv_band;
+        if (y < video_height) ffmpeg_yuv_convert_rows(rgba, yuv, y, std::min(y + yuv_band, video_height));
+        {
+            std::lock_guard<std::mutex> lock(yuv_mutex);
+            yuv_bands_left--;
+        }
+        yuv_done_cv.notify_all();
+    }
+}
+
+void ffmpeg_yuv_write() {
+    while (true) {
+        std::vector<unsigned char>* buffer;
+        {
+            std::unique_lock<std::mutex> lock(yuv_mutex);
+            yuv_cv.wait(lock, []() { return yuv_pending != nullptr || !yuv_running; });
+            if (yuv_pending == nullptr) break;
+            buffer = yuv_pending;
+        }
+        if (fwrite(buffer->data(), buffer->size(), 1, ffmpeg) != 1) video_renderer_failed = true;
+        {
+            std::lock_guard<std::mutex> lock(yuv_mutex);
+            yuv_pending = nullptr;
+        }
+        yuv_done_cv.notify_all();
+    }
+}
+
+void ffmpeg_yuv_init(int w, int h, bool alpha) {
+    size_t size = (size_t)w * h + (size_t)((w + 1) / 2) * ((h + 1) / 2) * 2;
+    if (alpha) size += (size_t)w * h;
+    yuv_buffers[0].resize(size);
+    yuv_buffers[1].resize(size);
+    yuv_current = 0;
+    yuv_alpha = alpha;
+    int threads = std::thread::hardware_concurrency();
+    if (threads < 1) threads = 1;
+    // bands are kept an even number of rows tall so no chroma row is shared
+    yuv_band = ((h + threads - 1) / threads + 1) & ~1;
+    yuv_generation = 0;
+    yuv_pending = nullptr;
+    yuv_running = true;
+    for (int i = 0; i < threads - 1; i++) {
+        yuv_workers.push_back(std::thread(ffmpeg_yuv_work, i));
+    }
+    yuv_writer = std::thread(ffmpeg_yuv_write);
+}
+
+void ffmpeg_yuv_render(unsigned char* data) {
+    if (!ffmpeg) return;
+    unsigned char* yuv = yuv_buffers[yuv_current].data();
+    {
+        std::lock_guard<std::mutex> lock(yuv_mutex);
+        yuv_rgba = data;
+        yuv_target = yuv;
+        yuv_bands_left = yuv_workers.size();
+        yuv_generation++;
+    }
+    yuv_cv.notify_all();
+    ffmpeg_yuv_convert_rows(data, yuv, 0, std::min(yuv_band, video_height));
+    {
+        // the other buffer has to be written out before it's handed over again
+        std::unique_lock<std::mutex> lock(yuv_mutex);
+        yuv_done_cv.wait(lock, []() { return yuv_bands_left == 0 && yuv_pending == nullptr; });
+        yuv_pending = &yuv_buffers[yuv_current];
+    }
+    yuv_cv.notify_all();
+    yuv_current ^= 1;
+}
+
+void ffmpeg_yuv_finalize() {
+    if (!ffmpeg) return;
+    {
+        std::unique_lock<std::mutex> lock(yuv_mutex);
+        yuv_done_cv.wait(lock, []() { return yuv_pending == nullptr; });
+        yuv_running = false;
+    }
+    yuv_cv.notify_all();
+    for (std::thread& worker : yuv_workers) {
+        worker.join();
+    }
+    yuv_workers.clear();
+    yuv_writer.join();
+    if (pclose(ffmpeg) != 0) video_renderer_failed = true;
+}
+
+// Returns false if ffmpeg couldn't be started, the rest of the video is then
+// skipped and no YUV workers are started for it
+bool ffmpeg_open(const std::string& cmd) {
 #ifdef _WIN32
     ffmpeg = popen(cmd.c_str(), "wb");
 #else
     ffmpeg = popen(cmd.c_str(), "w");
 #endif
+    if (ffmpeg) return true;
+    std::cout << "Failed starting ffmpeg for " << output << std::endl;
+    video_renderer_failed = true;
+    return false;
+}
+
+void webm_init(int w, int h, bool fps60) {
+    video_width = w;
+    video_height = h;
+    std::string cmd = "ffmpeg -y -r " + std::string(fps60 ? "60" : "30") + " -f rawvideo -pix_fmt yuva420p -s " + std::to_string(w) + "x" + std::to_string(h) + " -i - -c:v libvpx-vp9 -pix_fmt yuva420p \"" + output + "\"";
+    if (!ffmpeg_open(cmd)) return;
+    setvbuf(ffmpeg, NULL, _IOFBF, 1 << 20);
+    ffmpeg_yuv_init(w, h, true);
 }
 
 void mp4_init(int w, int h, bool fps60) {
     video_width = w;
     video_height = h;
-    std::string cmd = "ffmpeg -y -r " + std::string(fps60 ? "60" : "30") + " -f rawvideo -pix_fmt rgba -s " + std::to_string(w) + "x" + std::to_string(h) + " -i - -c:v h264 -pix_fmt yuv420p \"" + output + "\"";
-#ifdef _WIN32
-    ffmpeg = popen(cmd.c_str(), "wb");
-#else
-    ffmpeg = popen(cmd.c_str(), "w");
-#endif
+    std::string cmd = "ffmpeg -y -r " + std::string(fps60 ? "60" : "30") + " -f rawvideo -pix_fmt yuv420p -s " + std::to_string(w) + "x" + std::to_string(h) + " -i - -c:v h264 -pix_fmt yuv420p \"" + output + "\"";
+    if (!ffmpeg_open(cmd)) return;
+    setvbuf(ffmpeg, NULL, _IOFBF, 1 << 20);
+    ffmpeg_yuv_init(w, h, false);
 }
 
 void gif_init(int w, int h, bool fps60) {
     video_width = w;
     video_height = h;
     std::string cmd = "ffmpeg -y -r 30 -f rawvideo -pix_fmt rgba -s " + std::to_string(w) + "x" + std::to_string(h) + " -i -  -vf \"format=rgba,split[s0][s1];[s0]palettegen[p];[s1][p]paletteuse\" \"" + output + "\"";
-#ifdef _WIN32
-    ffmpeg = popen(cmd.c_str(), "wb");
-#else
-    ffmpeg = popen(cmd.c_str(), "w");
-#endif
+    ffmpeg_open(cmd);
 }
 
 void mov_init(int w, int h, bool fps60) {
     video_width = w;
     video_height = h;
     std::string cmd = "ffmpeg -y -r " + std::string(fps60 ? "60" : "30") + " -f rawvideo -pix_fmt rgba -s " + std::to_string(w) + "x" + std::to_string(h) + " -i - -c:v qtrle -pix_fmt argb \"" + output + "\"";
-#ifdef _WIN32
-    ffmpeg = popen(cmd.c_str(), "wb");
-#else
-    ffmpeg = popen(cmd.c_str(), "w");
-#endif
+    ffmpeg_open(cmd);
 }
 
 void ffmpeg_render(unsigned char* data) {
-    fwrite(data, video_width * video_height * 4, 1, ffmpeg);
+    if (!ffmpeg) return;
+    if (fwrite(data, video_width * video_height * 4, 1, ffmpeg) != 1) video_renderer_failed = true;
 }
 
 void ffmpeg_finalize() {
-    fclose(ffmpeg);
+    if (!ffmpeg) return;
+    if (pclose(ffmpeg) != 0) video_renderer_failed = true;
 }
 
 VideoRenderer renderer_pngseq = {
     pngseq_init,
     pngseq_render,
     pngseq_finalize,
-    VIDEO_RENDERER_FLAGS_TRANSPARECY | VIDEO_RENDERER_FLAGS_60FPS,
+    VIDEO_RENDERER_FLAGS_TRANSPARECY | VIDEO_RENDERER_FLAGS_60FPS | VIDEO_RENDERER_FLAGS_CHUNKS,
 };
 
 VideoRenderer renderer_webm = {
     webm_init,
-    ffmpeg_render,
-    ffmpeg_finalize,
-    VIDEO_RENDERER_FLAGS_FFMPEG | VIDEO_RENDERER_FLAGS_TRANSPARECY | VIDEO_RENDERER_FLAGS_60FPS,
+    ffmpeg_yuv_render,
+    ffmpeg_yuv_finalize,
+    VIDEO_RENDERER_FLAGS_FFMPEG | VIDEO_RENDERER_FLAGS_TRANSPARECY | VIDEO_RENDERER_FLAGS_60FPS | VIDEO_RENDERER_FLAGS_AUDIO | VIDEO_RENDERER_FLAGS_CHUNKS,
 };
 
 VideoRenderer renderer_mp4 = {
     mp4_init,
-    ffmpeg_render,
-    ffmpeg_finalize,
-    VIDEO_RENDERER_FLAGS_FFMPEG | VIDEO_RENDERER_FLAGS_60FPS,
+    ffmpeg_yuv_render,
+    ffmpeg_yuv_finalize,
+    VIDEO_RENDERER_FLAGS_FFMPEG | VIDEO_RENDERER_FLAGS_60FPS | VIDEO_RENDERER_FLAGS_AUDIO | VIDEO_RENDERER_FLAGS_CHUNKS,
 };
 
 VideoRenderer renderer_gif = {
@@ -117,7 +367,7 @@ VideoRenderer renderer_mov = {
     mov_init,
     ffmpeg_render,
     ffmpeg_finalize,
-    VIDEO_RENDERER_FLAGS_FFMPEG | VIDEO_RENDERER_FLAGS_TRANSPARECY | VIDEO_RENDERER_FLAGS_60FPS,
+    VIDEO_RENDERER_FLAGS_FFMPEG | VIDEO_RENDERER_FLAGS_TRANSPARECY | VIDEO_RENDERER_FLAGS_60FPS | VIDEO_RENDERER_FLAGS_AUDIO | VIDEO_RENDERER_FLAGS_CHUNKS,
 };
 
 std::vector<std::pair<std::pair<std::string, std::string>, VideoRenderer>> video_renderers =  {
@@ -132,8 +382,11 @@ FUNC(video_renderer_init      FUNC_INIT    ) = nullptr;
 FUNC(video_renderer_render    FUNC_RENDER  ) = nullptr;
 FUNC(video_renderer_finalize  FUNC_FINALIZE) = nullptr;
 int  video_renderer_flags                    = VIDEO_RENDERER_FLAGS_NONE;
+int  video_png_compression                   = 8;
+int  video_first_frame                       = 0;
+std::atomic<bool> video_renderer_failed      = false; // set by the encoder and PNG workers too
 
-void saturn_set_video_destination(std::string filename) {
+bool saturn_set_video_destination(std::string filename) {
     int index = -1;
     std::string ext = std::filesystem::path(filename).extension().string();
     for (int i = 0; i < video_renderers.size(); i++) {
@@ -143,13 +396,14 @@ void saturn_set_video_destination(std::string filename) {
             break;
         }
     }
-    if (index == -1) return;
+    if (index == -1) return false;
     VideoRenderer video_renderer = video_renderers[index].second;
     video_renderer_init     = std::get<0>(video_renderer);
     video_renderer_render   = std::get<1>(video_renderer);
     video_renderer_finalize = std::get<2>(video_renderer);
     video_renderer_flags    = std::get<3>(video_renderer);
     output = filename;
+    return true;
 }
 
 std::vector<std::string> video_renderer_get_formats(bool ffmpeg) {
@@ -166,3 +420,390 @@ std::vector<std::string> video_renderer_get_formats(bool ffmpeg) {
     }
     return formats;
 }
+
+// Frame queue
+// Single producer (the render thread) / single consumer (the encoder worker)
+// ring of preallocated frame buffers. Slots are handed over through the atomic
+// head and tail counters alone. The mutex is only taken to sleep when there is
+// nothing to do, and by the other side to wake it: a side flags that it's
+// waiting before checking the counters one last time, and the other side
+// checks the flag after moving its counter, so one of them always sees the other.
+
+std::vector<unsigned char*> queue_slots = {};
+std::atomic<uint64_t> queue_head = 0; // next slot the encoder reads
+std::atomic<uint64_t> queue_tail = 0; // next slot the renderer writes
+std::atomic<bool> queue_running = false;
+std::atomic<bool> queue_encoder_waiting = false;
+std::atomic<bool> queue_renderer_waiting = false;
+std::atomic<int> queue_encoded = 0;
+double queue_stall_time = 0;
+std::mutex queue_mutex;
+std::condition_variable queue_cv;
+std::thread queue_worker;
+
+// the flag and counter accesses are sequentially consistent, that's what
+// keeps a wakeup from slipping between the last check and the sleep
+void video_renderer_queue_wait(std::atomic<bool>& waiting, const std::function<bool()>& ready) {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    waiting = true;
+    queue_cv.wait(lock, ready);
+    waiting = false;
+}
+
+void video_renderer_queue_wake(std::atomic<bool>& waiting) {
+    if (!waiting) return;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+    }
+    queue_cv.notify_all();
+}
+
+void video_renderer_queue_work() {
+    while (true) {
+        uint64_t head = queue_head.load(std::memory_order_relaxed);
+        if (head == queue_tail) {
+            video_renderer_queue_wait(queue_encoder_waiting, [head]() { return head != queue_tail || !queue_running; });
+            if (head == queue_tail) break;
+        }
+        video_renderer_render(queue_slots[head % queue_slots.size()]);
+        queue_head = head + 1;
+        queue_encoded++;
+        video_renderer_queue_wake(queue_renderer_waiting);
+    }
+}
+
+void video_renderer_queue_start(int w, int h, int depth) {
+    if (depth < 1) depth = 1;
+    for (int i = 0; i < depth; i++) {
+        queue_slots.push_back((unsigned char*)malloc((size_t)w * (size_t)h * 4));
+    }
+    queue_head = 0;
+    queue_tail = 0;
+    queue_encoded = 0;
+    queue_stall_time = 0;
+    queue_running = true;
+    queue_worker = std::thread(video_renderer_queue_work);
+}
+
+// Returns a free buffer to render into, waiting for the encoder if the queue
+// is full. Every frame of a video has to be written, so none are dropped.
+unsigned char* video_renderer_queue_acquire() {
+    if (!queue_running) return nullptr;
+    uint64_t tail = queue_tail.load(std::memory_order_relaxed);
+    if (tail - queue_head >= queue_slots.size()) {
+        auto start = std::chrono::steady_clock::now();
+        video_renderer_queue_wait(queue_renderer_waiting, [tail]() { return tail - queue_head < queue_slots.size(); });
+        queue_stall_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return queue_slots[tail % queue_slots.size()];
+}
+
+void video_renderer_queue_submit() {
+    queue_tail = queue_tail.load(std::memory_order_relaxed) + 1;
+    video_renderer_queue_wake(queue_encoder_waiting);
+}
+
+// Encodes whatever is still queued and frees the buffers
+void video_renderer_queue_stop() {
+    if (!queue_running) return;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue_running = false;
+    }
+    queue_cv.notify_all();
+    if (queue_worker.joinable()) queue_worker.join();
+    for (unsigned char* slot : queue_slots) {
+        free(slot);
+    }
+    queue_slots.clear();
+}
+
+VideoRendererQueueStats video_renderer_queue_get_stats() {
+    VideoRendererQueueStats stats;
+    stats.depth = (int)(queue_tail - queue_head);
+    stats.capacity = (int)queue_slots.size();
+    stats.encoded = queue_encoded;
+    stats.stall_time = queue_stall_time;
+    return stats;
+}
+
+// Audio track
+// The game's audio is written to a WAV next to the output while rendering.
+// Formats that can carry audio get it muxed in once the video is finalized,
+// the others (PNG sequences, GIFs) keep the WAV as a sidecar.
+
+FILE* audio_file = nullptr;
+std::string audio_path;
+uint32_t audio_length;
+
+void video_renderer_audio_header(uint32_t data_size) {
+    uint32_t rate = VIDEO_RENDERER_AUDIO_RATE;
+    uint32_t byte_rate = rate * 4;
+    uint32_t riff_size = data_size + 36;
+    uint32_t fmt_size = 16;
+    uint16_t format = 1, channels = 2, block_align = 4, bits = 16;
+    fseek(audio_file, 0, SEEK_SET);
+    fwrite("RIFF", 1, 4, audio_file);
+    fwrite(&riff_size, 4, 1, audio_file);
+    fwrite("WAVEfmt ", 1, 8, audio_file);
+    fwrite(&fmt_size, 4, 1, audio_file);
+    fwrite(&format, 2, 1, audio_file);
+    fwrite(&channels, 2, 1, audio_file);
+    fwrite(&rate, 4, 1, audio_file);
+    fwrite(&byte_rate, 4, 1, audio_file);
+    fwrite(&block_align, 2, 1, audio_file);
+    fwrite(&bits, 2, 1, audio_file);
+    fwrite("data", 1, 4, audio_file);
+    fwrite(&data_size, 4, 1, audio_file);
+}
+
+std::string video_chunk_audio_path(int chunk);
+
+void video_renderer_audio_begin(int chunk) {
+    // PNG sequence chunks all write to the same output name, so each chunk's
+    // track gets its own file until they're joined
+    if (chunk >= 0) audio_path = video_chunk_audio_path(chunk);
+    else audio_path = output.substr(0, output.find_last_of(".")) + ".wav";
+    audio_file = fopen(audio_path.c_str(), "wb");
+    audio_length = 0;
+    if (audio_file) video_renderer_audio_header(0);
+}
+
+// count is in stereo sample frames
+void video_renderer_audio_write(short* samples, int count) {
+    if (!audio_file) return;
+    fwrite(samples, 4, count, audio_file);
+    audio_length += count * 4;
+}
+
+void video_renderer_audio_end() {
+    if (!audio_file) return;
+    video_renderer_audio_header(audio_length);
+    fclose(audio_file);
+    audio_file = nullptr;
+    if (!(video_renderer_flags & VIDEO_RENDERER_FLAGS_AUDIO)) return;
+    std::filesystem::path video = output;
+    std::filesystem::path muxed = video.parent_path() / (video.stem().string() + ".mux" + video.extension().string());
+    std::string codec = video.extension() == ".webm" ? "libopus" : "aac";
+    std::string cmd = "ffmpeg -y -loglevel error -i \"" + video.string() + "\" -i \"" + audio_path + "\" -c:v copy -c:a " + codec + " -shortest \"" + muxed.string() + "\"";
+    if (system(cmd.c_str()) != 0) {
+        video_renderer_failed = true;
+        return;
+    }
+    std::error_code error;
+    std::filesystem::rename(muxed, video, error);
+    if (!error) std::filesystem::remove(audio_path, error);
+}
+
+// Chunked renders
+// The timeline is split into chunks that are rendered into their own files,
+// finished chunks are listed in a manifest next to the output so a render
+// can be resumed, or split across several processes. Once every chunk is
+// listed they are joined with ffmpeg's concat demuxer without re-encoding.
+// PNG sequences are written straight to their final names, only their audio
+// is joined. The manifest records the settings chunks were rendered with,
+// chunks are only joined if all of them match.
+
+std::string chunks_output;
+std::string chunks_manifest;
+std::string chunks_settings;
+int chunks_count;
+int chunks_flags;
+
+int video_chunks_begin(std::string path, int num_frames, int chunk_frames, std::string settings) {
+    chunks_output = path;
+    chunks_manifest = path + ".chunks";
+    chunks_settings = settings;
+    chunks_count = (num_frames + chunk_frames - 1) / chunk_frames;
+    chunks_flags = video_renderer_flags;
+    std::string header = "saturn-chunks " + std::to_string(num_frames) + " " + std::to_string(chunk_frames) + " " + settings;
+    std::ifstream manifest = std::ifstream(chunks_manifest);
+    std::string line;
+    if (manifest.good() && std::getline(manifest, line) && line == header) return chunks_count;
+    manifest.close();
+    // missing or made for different settings, start over
+    std::ofstream(chunks_manifest) << header << std::endl;
+    return chunks_count;
+}
+
+bool video_chunk_is_done(int chunk) {
+    // read every time, other processes might have finished chunks meanwhile
+    std::ifstream manifest = std::ifstream(chunks_manifest);
+    std::string line;
+    std::string done = std::to_string(chunk) + " " + chunks_settings;
+    std::getline(manifest, line);
+    while (std::getline(manifest, line)) {
+        if (line == done) return true;
+    }
+    return false;
+}
+
+std::string video_chunk_path(int chunk) {
+    if (!(chunks_flags & VIDEO_RENDERER_FLAGS_FFMPEG)) return chunks_output;
+    std::filesystem::path path = chunks_output;
+    char index[16];
+    snprintf(index, sizeof(index), ".chunk%04d", chunk);
+    return (path.parent_path() / (path.stem().string() + index + path.extension().string())).string();
+}
+
+std::string video_chunk_audio_path(int chunk) {
+    std::filesystem::path path = chunks_output;
+    char index[16];
+    snprintf(index, sizeof(index), ".chunk%04d", chunk);
+    return (path.parent_path() / (path.stem().string() + index + ".wav")).string();
+}
+
+void video_chunk_finish(int chunk) {
+    std::ofstream(chunks_manifest, std::ios::app) << chunk << " " << chunks_settings << std::endl;
+}
+
+// Every chunk must be listed with the settings the manifest was started with
+bool video_chunks_check() {
+    std::ifstream manifest = std::ifstream(chunks_manifest);
+    std::string line;
+    if (!std::getline(manifest, line)) return false;
+    // saturn-chunks <frames> <chunk frames> <settings>
+    std::istringstream header = std::istringstream(line);
+    std::string magic, frames, chunk_frames, header_settings;
+    header >> magic >> frames >> chunk_frames >> std::ws;
+    std::getline(header, header_settings);
+    if (header_settings != chunks_settings) {
+        video_renderer_failed = true;
+        std::cout << "Not joining chunks of " << chunks_output << ", the manifest was started with different settings (" << header_settings << ")" << std::endl;
+        return false;
+    }
+    std::vector<bool> done = std::vector<bool>(chunks_count, false);
+    while (std::getline(manifest, line)) {
+        size_t space = line.find(' ');
+        int chunk = atoi(line.substr(0, space).c_str());
+        std::string settings = space == std::string::npos ? "" : line.substr(space + 1);
+        if (settings != chunks_settings) {
+            video_renderer_failed = true;
+            std::cout << "Not joining chunks of " << chunks_output << ", chunk " << chunk << " was rendered with different settings (" << settings << ")" << std::endl;
+            return false;
+        }
+        if (chunk >= 0 && chunk < chunks_count) done[chunk] = true;
+    }
+    return std::find(done.begin(), done.end(), false) == done.end();
+}
+
+// Joins the chunk WAVs of a PNG sequence into one track next to the frames
+void video_chunks_concat_audio() {
+    std::error_code error;
+    if (!std::filesystem::exists(video_chunk_audio_path(0))) return;
+    audio_path = chunks_output.substr(0, chunks_output.find_last_of(".")) + ".wav";
+    audio_file = fopen(audio_path.c_str(), "wb");
+    if (!audio_file) return;
+    audio_length = 0;
+    video_renderer_audio_header(0);
+    std::vector<char> buffer = std::vector<char>(1 << 16);
+    for (int i = 0; i < chunks_count; i++) {
+        std::string path = video_chunk_audio_path(i);
+        FILE* chunk = fopen(path.c_str(), "rb");
+        if (!chunk) continue;
+        fseek(chunk, 44, SEEK_SET); // header written by video_renderer_audio_header
+        size_t read;
+        while ((read = fread(buffer.data(), 1, buffer.size(), chunk)) > 0) {
+            fwrite(buffer.data(), 1, read, audio_file);
+            audio_length += read;
+        }
+        fclose(chunk);
+        std::filesystem::remove(path, error);
+    }
+    video_renderer_audio_header(audio_length);
+    fclose(audio_file);
+    audio_file = nullptr;
+}
+
+bool video_process_running(int pid) {
+#ifdef _WIN32
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (!process) return false;
+    bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return running;
+#else
+    return kill(pid, 0) == 0 || errno == EPERM;
+#endif
+}
+
+// The lock holds the PID of the joining process, a lock left behind by a
+// process that's gone is taken over. Returns false if a running process holds it.
+bool video_chunks_lock(std::string lock_path) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int lock = open(lock_path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+        if (lock >= 0) {
+#ifdef _WIN32
+            std::string pid = std::to_string(_getpid());
+#else
+            std::string pid = std::to_string(getpid());
+#endif
+            bool written = write(lock, pid.c_str(), pid.size()) == (int)pid.size();
+            close(lock);
+            if (written) return true;
+            std::error_code error;
+            std::filesystem::remove(lock_path, error);
+            return false;
+        }
+        int holder = 0;
+        std::ifstream(lock_path) >> holder;
+        // an empty lock was only just created by another process
+        if (holder <= 0 || video_process_running(holder)) {
+            std::cout << "Not joining chunks of " << chunks_output << ", " << lock_path << " is held by process " << holder << std::endl;
+            return false;
+        }
+        std::cout << "Taking over " << lock_path << " from process " << holder << " that's gone" << std::endl;
+        std::error_code error;
+        std::filesystem::remove(lock_path, error);
+    }
+    return false;
+}
+
+bool video_chunks_concat() {
+    int pending = 0;
+    for (int i = 0; i < chunks_count; i++) {
+        if (!video_chunk_is_done(i)) pending++;
+    }
+    if (pending != 0) {
+        std::cout << "Not joining chunks of " << chunks_output << " yet, " << pending << " of " << chunks_count << " still need rendering" << std::endl;
+        return false;
+    }
+    // several processes can finish at once, only the one that creates the lock joins
+    std::string lock_path = chunks_output + ".concat.lock";
+    if (!video_chunks_lock(lock_path)) {
+        video_renderer_failed = true;
+        return false;
+    }
+    std::error_code error;
+    // the manifest might be gone if another process joined them just before
+    if (!video_chunks_check()) {
+        std::filesystem::remove(lock_path, error);
+        return false;
+    }
+    if (chunks_flags & VIDEO_RENDERER_FLAGS_FFMPEG) {
+        std::string list_path = chunks_output + ".concat.txt";
+        std::ofstream list = std::ofstream(list_path);
+        for (int i = 0; i < chunks_count; i++) {
+            list << "file '" << std::filesystem::absolute(video_chunk_path(i)).string() << "'" << std::endl;
+        }
+        list.close();
+        std::filesystem::path output = chunks_output;
+        std::filesystem::path joined = output.parent_path() / (output.stem().string() + ".concat" + output.extension().string());
+        std::string cmd = "ffmpeg -y -loglevel error -f concat -safe 0 -i \"" + list_path + "\" -c copy \"" + joined.string() + "\"";
+        int result = system(cmd.c_str());
+        std::filesystem::remove(list_path, error);
+        if (result == 0) std::filesystem::rename(joined, output, error);
+        if (result != 0 || error) {
+            video_renderer_failed = true;
+            std::filesystem::remove(lock_path, error);
+            return false;
+        }
+        for (int i = 0; i < chunks_count; i++) {
+            std::filesystem::remove(video_chunk_path(i), error);
+        }
+    }
+    else video_chunks_concat_audio();
+    std::filesystem::remove(chunks_manifest, error);
+    std::filesystem::remove(lock_path, error);
+    return true;
+}
@@ -1,6 +1,7 @@
 #ifndef SaturnVideoRenderer
 #define SaturnVideoRenderer
 
+#include <atomic>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -18,13 +19,43 @@ extern FUNC(video_renderer_init      FUNC_INIT    );
 extern FUNC(video_renderer_render    FUNC_RENDER  );
 extern FUNC(video_renderer_finalize  FUNC_FINALIZE);
 extern int  video_renderer_flags;
-
-extern void saturn_set_video_destination(std::string path);
+extern int  video_png_compression;
+extern int  video_first_frame;
+extern std::atomic<bool> video_renderer_failed;
+
+struct VideoRendererQueueStats {
+    int depth;
+    int capacity;
+    int encoded;
+    double stall_time;
+};
+
+extern bool saturn_set_video_destination(std::string path);
+
+extern void video_renderer_queue_start(int w, int h, int depth);
+extern unsigned char* video_renderer_queue_acquire();
+extern void video_renderer_queue_submit();
+extern void video_renderer_queue_stop();
+extern VideoRendererQueueStats video_renderer_queue_get_stats();
+
+extern void video_renderer_audio_begin(int chunk);
+extern void video_renderer_audio_write(short* samples, int count);
+extern void video_renderer_audio_end();
+
+extern int video_chunks_begin(std::string path, int num_frames, int chunk_frames, std::string settings);
+extern bool video_chunk_is_done(int chunk);
+extern std::string video_chunk_path(int chunk);
+extern void video_chunk_finish(int chunk);
+extern bool video_chunks_concat();
 extern std::vector<std::string> video_renderer_get_formats(bool ffmpeg);
 
 #define VIDEO_RENDERER_FLAGS_NONE        0
 #define VIDEO_RENDERER_FLAGS_TRANSPARECY (1 << 0)
 #define VIDEO_RENDERER_FLAGS_FFMPEG      (1 << 1)
 #define VIDEO_RENDERER_FLAGS_60FPS       (1 << 2)
+#define VIDEO_RENDERER_FLAGS_AUDIO       (1 << 3)
+#define VIDEO_RENDERER_FLAGS_CHUNKS      (1 << 4)
+
+#define VIDEO_RENDERER_AUDIO_RATE 32000
 
 #endif